@@ -4,11 +4,22 @@
 #include <vector>
 #include <algorithm>
 #include <mutex>
+#include <ctime>
 #include <ubench/ubench.hpp>
 
 #include <udisruptor/ring_buffer.hpp>
 #include <udisruptor/multisequencer.hpp>
 #include <udisruptor/sequencer.hpp>
+#include <udisruptor/stamped_ring_buffer.hpp>
+#include <udisruptor/cursor_availability.hpp>
+#include <udisruptor/multilane_ring_buffer.hpp>
+#include <udisruptor/staging_producer.hpp>
+#include <udisruptor/claim_combiner.hpp>
+#include <udisruptor/gating_tree.hpp>
+#include <udisruptor/barrier.hpp>
+#include <udisruptor/batch_event_processor.hpp>
+#include <udisruptor/worker_pool.hpp>
+#include <udisruptor/topology.hpp>
 
 
 constexpr auto events_count = 10000000;
@@ -34,37 +45,126 @@ template<typename S > void microbench(char const* title) {
 }
 
 
-int main() {
+template<typename W> void wait_strategy_bench(char const* title) {
+  using namespace std::chrono;
+  constexpr auto round_trips = 20000;
 
-  microbench<udisruptor::sequencer>("sequencer");
-  microbench<udisruptor::multisequencer>("multisequencer");
+  udisruptor::sequence ping, pong;
+  udisruptor::basic_barrier<W> ping_barrier, pong_barrier;
+  ping_barrier.depends_on(ping);
+  pong_barrier.depends_on(pong);
 
-  udisruptor::ring_buffer<int64_t> buffer{buffer_size};
-  udisruptor::multisequencer sequencer{buffer.capacity()};
+  auto const cpu_started = std::clock();
+  auto const started = steady_clock::now();
+
+  auto echo = std::thread{[&] {
+    for(auto i = 0; i != round_trips; ++i) {
+      ping_barrier.wait(i);
+      pong = i;
+      pong_barrier.notify();
+    }
+  }};
+
+  for(auto i = 0; i != round_trips; ++i) {
+    ping = i;
+    ping_barrier.notify();
+    pong_barrier.wait(i);
+  }
+
+  echo.join();
+
+  auto const wall = duration<double>(steady_clock::now() - started).count();
+  auto const cpu = double(std::clock() - cpu_started) / CLOCKS_PER_SEC;
+  auto const round_trip_ns = wall * 1000000000 / round_trips;
+
+  printf("%s round trip - %.0f ns, CPU usage - %.2f cores\n",
+         title, round_trip_ns, cpu / wall);
+}
+
+
+template<typename A> void scan_bench(char const* title) {
+  constexpr auto capacity = 1 << 20;
+  udisruptor::basic_multisequencer<udisruptor::yielding_wait, A> sequencer{capacity};
+  sequencer.add_consumer();
+  auto const first = sequencer.claim(capacity);
+  sequencer.publish(first, first + capacity - 1);
+
+  auto const scan_us = ubench::run([&] {
+    if(sequencer.try_fetch_all(first) != first + capacity)
+      puts("Oops");
+  });
+
+  printf("%s scan - %.2f ns/event\n", title, scan_us.time.count() / capacity);
+}
+
+// Padded event which producers stamp with its index in the first word
+template<std::size_t N> struct sized_event {
+  int64_t words[N / sizeof(int64_t)];
+
+  sized_event& operator = (int64_t index) noexcept {
+    words[0] = index;
+    return *this;
+  }
+
+  bool operator != (int64_t index) const noexcept {
+    return words[0] != index;
+  }
+};
+
+
+// Events live in ring_buffer<T>, availability in the sequencer
+template<typename T, typename S = udisruptor::multisequencer,
+         typename B = udisruptor::ring_buffer<T>>
+struct split_layout {
+  B buffer;
+  S sequencer;
+
+  split_layout(): buffer{buffer_size}, sequencer{buffer.capacity()} { }
+  T& operator [] (int64_t n) noexcept { return buffer[n]; }
+  S& producer() noexcept { return sequencer; }
+};
+
+
+// Each producer thread claims through a handle with its own gating cache
+template<typename T> struct handle_layout: split_layout<T> {
+  auto producer() noexcept { return this->sequencer.make_producer(); }
+};
+
+
+// Events live next to their stamps
+template<typename T> struct stamped_layout {
+  udisruptor::stamped_ring_buffer<T> sequencer{buffer_size};
+
+  T& operator [] (int64_t n) noexcept { return sequencer[n]; }
+  auto& producer() noexcept { return sequencer; }
+};
+
+
+template<typename L, typename F> double throughput_bench(int producers_count, F&& produce) {
+  L layout;
+  auto& sequencer = layout.sequencer;
   std::vector<std::chrono::nanoseconds> producer_timings;
   std::mutex producer_timings_sync;
 
-  constexpr auto events_per_producer = events_count / producers_count;
-  constexpr auto events_to_consume = events_per_producer * producers_count;
+  auto const events_per_producer = events_count / producers_count;
+  auto const events_to_consume = events_per_producer * producers_count;
 
   auto const consumer = [&](udisruptor::sequence* consumer_seq) {
     auto events_consumed = 0;
-    while(events_consumed != events_to_consume) {
+    for(;;) {
       auto const next = consumer_seq->next();
-      auto const until = sequencer.try_fetch_all(next);
-      if(until == next) {
-        std::this_thread::sleep_for(std::chrono::microseconds{20});
-        continue;
-      }
-      for(auto i = next; i != until; ++i) {
-        auto const value = buffer[i];
-        if(value != i)
+      auto const last = sequencer.wait_for(next);
+      if(last == udisruptor::sequence::alerted)
+        break;
+      for(auto i = next; i <= last; ++i) {
+        if(layout[i] != i)
           puts("Oops");
         ++events_consumed;
       }
-      *consumer_seq = until - 1;
+      *consumer_seq = last;
     }
-
+    if(events_consumed != events_to_consume)
+      puts("Oops");
   };
 
   std::vector<std::thread> consumers;
@@ -72,19 +172,10 @@ int main() {
   for(auto i = 0; i != consumers_count; ++i)
     consumers.emplace_back(std::thread{consumer, sequencer.add_consumer()});
 
-  if(!buffer || !sequencer) {
-    printf("Disruptor is not ready\n");
-    return 1;
-  }
-
   auto const producer = [&] {
     using namespace std::chrono;
     auto const started = steady_clock::now();
-    for(auto i = 0; i != events_per_producer; ++i) {
-      auto const index = sequencer.claim();
-      buffer[index] = index;
-      sequencer.publish(index);
-    }
+    produce(layout, events_per_producer);
     auto const ended = steady_clock::now();
     std::unique_lock g(producer_timings_sync);
     producer_timings.push_back(duration_cast<nanoseconds>(ended - started));
@@ -98,14 +189,446 @@ int main() {
   for(auto& producer: producers)
     producer.join();
 
+  sequencer.halt();
+
   for(auto& consumer: consumers)
     consumer.join();
 
   auto const max_timing = std::max_element(producer_timings.begin(), producer_timings.end());
-  double const events_per_ns = double(events_count) / max_timing->count();
-  double const events_per_s = events_per_ns * 1000000000;
+  double const events_per_ns = double(events_to_consume) / max_timing->count();
+  return events_per_ns * 1000000000;
+}
+
+
+template<typename L> double throughput_bench(int producers_count) {
+  return throughput_bench<L>(producers_count, [](L& layout, int events) {
+    auto&& claimer = layout.producer();
+    for(auto i = 0; i != events; ++i) {
+      auto const index = claimer.claim();
+      layout[index] = index;
+      claimer.publish(index);
+    }
+  });
+}
+
+
+// Producers claim through a flat combiner
+template<typename T> struct combining_layout: split_layout<T> {
+  udisruptor::claim_combiner<udisruptor::multisequencer> combiner{this->sequencer, 16};
+  auto producer() noexcept { return combiner.add_producer(); }
+};
+
+
+void combining_bench() {
+  for(auto producers_count: {2, 4, 8, 16}) {
+    auto const plain_per_s = throughput_bench<handle_layout<int64_t>>(producers_count);
+    auto const combining_per_s = throughput_bench<combining_layout<int64_t>>(producers_count);
+    printf("%d producers: plain claims - %.0f events/second, "
+           "combined claims - %.0f events/second\n",
+           producers_count, plain_per_s, combining_per_s);
+  }
+}
+
+
+void scrambling_bench() {
+  using scrambled = split_layout<int64_t,
+    udisruptor::basic_multisequencer<udisruptor::yielding_wait,
+                                     udisruptor::scrambled_availability>,
+    udisruptor::ring_buffer<int64_t, udisruptor::scrambled_index<sizeof(int64_t)>>>;
+  for(auto producers_count: {2, 4, 8}) {
+    auto const linear_per_s = throughput_bench<split_layout<int64_t>>(producers_count);
+    auto const scrambled_per_s = throughput_bench<scrambled>(producers_count);
+    printf("%d producers: linear slots - %.0f events/second, "
+           "scrambled slots - %.0f events/second\n",
+           producers_count, linear_per_s, scrambled_per_s);
+  }
+}
+
+
+void padding_bench() {
+  constexpr auto cacheline = udisruptor::sequence::cacheline;
+  using padded = split_layout<int64_t, udisruptor::multisequencer,
+    udisruptor::ring_buffer<int64_t, udisruptor::linear_index, cacheline>>;
+  for(auto producers_count: {2, 4, 8}) {
+    auto const packed_per_s = throughput_bench<split_layout<int64_t>>(producers_count);
+    auto const padded_per_s = throughput_bench<padded>(producers_count);
+    printf("%d producers: packed slots - %.0f events/second, "
+           "%zu-byte slots - %.0f events/second\n",
+           producers_count, packed_per_s, cacheline, padded_per_s);
+  }
+}
+
+
+// Gating check of a producer over all consumers against a gating tree root,
+// and what consumers pay to keep them up to date
+void gating_bench() {
+  for(auto consumers_count: {1, 8, 32, 128}) {
+    std::vector<udisruptor::sequence> consumers(consumers_count);
+    udisruptor::barrier flat;
+    for(auto& consumer: consumers)
+      flat.depends_on(consumer);
+
+    udisruptor::sequence root;
+    udisruptor::gating_tree tree{root, consumers_count};
+    std::vector<udisruptor::sequence*> leaves;
+    for(auto i = 0; i != consumers_count; ++i)
+      leaves.push_back(tree.add_consumer());
+    udisruptor::barrier gated;
+    gated.depends_on(root);
+
+    int64_t flat_last = 0, tree_last = 0;
+    auto const flat_commit = ubench::run([&] {
+      ++flat_last;
+      for(auto& consumer: consumers)
+        consumer = flat_last;
+    });
+    auto const flat_wait = ubench::run([&] {
+      if(flat.wait(flat_last) != flat_last)
+        puts("Oops");
+    });
+    auto const tree_commit = ubench::run([&] {
+      ++tree_last;
+      for(auto leaf: leaves)
+        tree.commit(*leaf, tree_last);
+    });
+    auto const tree_wait = ubench::run([&] {
+      if(gated.wait(tree_last) != tree_last)
+        puts("Oops");
+    });
+
+    printf("%d consumers: gating check - flat %.1f ns, tree %.1f ns; "
+           "commits of all consumers - flat %.1f ns, tree %.1f ns\n",
+           consumers_count, flat_wait.time.count(), tree_wait.time.count(),
+           flat_commit.time.count(), tree_commit.time.count());
+  }
+}
+
+
+template<std::size_t N> void fixed_consumers_bench() {
+  udisruptor::sequence consumers[N];
+  udisruptor::barrier dynamic;
+  udisruptor::basic_barrier<udisruptor::yielding_wait, N> fixed;
+  for(auto& consumer: consumers) {
+    dynamic.depends_on(consumer);
+    fixed.depends_on(consumer);
+    consumer = 0;
+  }
+  auto const dynamic_wait = ubench::run([&] {
+    if(dynamic.wait(0) < 0)
+      puts("Oops");
+  });
+  auto const fixed_wait = ubench::run([&] {
+    if(fixed.wait(0) < 0)
+      puts("Oops");
+  });
+  printf("%zu consumers: gating check - any number %.1f ns, fixed number %.1f ns\n",
+         N, dynamic_wait.time.count(), fixed_wait.time.count());
+}
+
+
+// Staged events do not know their index, so consumers do not check them
+struct staged_event {
+  int64_t value;
+
+  bool operator != (int64_t) const noexcept {
+    return false;
+  }
+};
+
+
+void staging_bench(int producers_count) {
+  using layout = handle_layout<staged_event>;
+  using handle = udisruptor::multisequencer::producer;
+  auto const direct_per_s = throughput_bench<layout>(producers_count, [](layout& l, int events) {
+    auto producer = l.producer();
+    for(auto i = 0; i != events; ++i) {
+      auto const index = producer.claim();
+      l.buffer[index] = staged_event{i};
+      producer.publish(index);
+    }
+  });
+  printf("%d producers: claim per event - %.0f events/second", producers_count, direct_per_s);
+  for(auto batch: {16, 64}) {
+    auto const staged_per_s = throughput_bench<layout>(producers_count, [&](layout& l, int events) {
+      auto producer = l.producer();
+      udisruptor::staging_producer<staged_event, handle> staging{l.buffer, producer, batch};
+      for(auto i = 0; i != events; ++i)
+        staging.push(staged_event{i});
+      staging.flush();
+    });
+    printf(", staged by %d - %.0f events/second", batch, staged_per_s);
+  }
+  printf("\n");
+}
+
+
+template<std::size_t N> void layout_bench() {
+  constexpr auto producers_count = 2;
+  using event = sized_event<N>;
+  auto const split_per_s = throughput_bench<split_layout<event>>(producers_count);
+  auto const stamped_per_s = throughput_bench<stamped_layout<event>>(producers_count);
+  printf("%zu-byte events: split - %.0f events/second, stamped - %.0f events/second\n",
+         N, split_per_s, stamped_per_s);
+}
+
+
+double multilane_bench(int producers_count) {
+  udisruptor::multilane_ring_buffer<int64_t> ring{producers_count, buffer_size / producers_count};
+  std::vector<std::chrono::nanoseconds> producer_timings;
+  std::mutex producer_timings_sync;
+
+  auto const events_per_producer = events_count / producers_count;
+  auto const events_to_consume = events_per_producer * producers_count;
+
+  auto consumer = std::thread{[&, c = ring.add_consumer()]() mutable {
+    auto events_consumed = 0;
+    for(;;) {
+      auto const handled = ring.drain(c, [&](int64_t value) {
+        if(value >= events_per_producer)
+          puts("Oops");
+      });
+      if(handled == udisruptor::sequence::alerted)
+        break;
+      events_consumed += handled;
+    }
+    if(events_consumed != events_to_consume)
+      puts("Oops");
+  }};
+
+  auto const producer = [&](int p) {
+    using namespace std::chrono;
+    auto& lane = ring.producer(p);
+    auto const started = steady_clock::now();
+    for(auto i = 0; i != events_per_producer; ++i) {
+      auto const index = lane.claim();
+      lane[index] = index;
+      lane.publish(index);
+    }
+    auto const ended = steady_clock::now();
+    std::unique_lock g(producer_timings_sync);
+    producer_timings.push_back(duration_cast<nanoseconds>(ended - started));
+  };
+
+  std::vector<std::thread> producers;
+  producers.reserve(producers_count);
+  for(auto i = 0; i != producers_count; ++i)
+    producers.emplace_back(std::thread{producer, i});
+
+  for(auto& producer: producers)
+    producer.join();
+
+  ring.halt();
+  consumer.join();
+
+  auto const max_timing = std::max_element(producer_timings.begin(), producer_timings.end());
+  double const events_per_ns = double(events_to_consume) / max_timing->count();
+  return events_per_ns * 1000000000;
+}
+
+
+void producers_bench() {
+  for(auto producers_count: {1, 2, 4, 8}) {
+    auto const shared_per_s = throughput_bench<split_layout<int64_t>>(producers_count);
+    auto const handle_per_s = throughput_bench<handle_layout<int64_t>>(producers_count);
+    auto const multilane_per_s = multilane_bench(producers_count);
+    printf("%d producers: shared gating cache - %.0f events/second, "
+           "producer handles - %.0f events/second, "
+           "multilane - %.0f events/second\n",
+           producers_count, shared_per_s, handle_per_s, multilane_per_s);
+  }
+}
+
 
+template<typename A> void cursor_bench(char const* title) {
+  using sequencer = udisruptor::basic_multisequencer<udisruptor::yielding_wait, A>;
+  printf("%s throughput -", title);
+  for(auto producers_count: {2, 4})
+    printf(" %d producers: %.0f events/second;", producers_count,
+           throughput_bench<split_layout<int64_t, sequencer>>(producers_count));
+  printf("\n");
+}
+
+
+struct summing_handler {
+  int64_t sum{0};
+
+  void operator () (int64_t& event, int64_t, bool) noexcept {
+    sum += event;
+  }
+};
+
+
+void processor_bench() {
+  constexpr auto events = 5000000;
+  auto const run = [&](auto&& consume) {
+    udisruptor::ring_buffer<int64_t> buffer{4096};
+    udisruptor::sequencer sequencer{buffer.capacity()};
+    auto const started = std::chrono::steady_clock::now();
+    auto const consumed = consume(buffer, sequencer, [&] {
+      for(auto i = 0; i != events; ++i) {
+        auto const index = sequencer.claim();
+        buffer[index] = index;
+        sequencer.publish(index);
+      }
+      sequencer.halt();
+    });
+    std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - started;
+    if(consumed != int64_t(events) * (events - 1) / 2)
+      puts("Oops");
+    return events / elapsed.count() / 1e6;
+  };
+
+  auto const hand_written = run([](auto& buffer, auto& sequencer, auto&& produce) {
+    auto consumer_seq = sequencer.add_consumer();
+    int64_t sum = 0;
+    std::thread consumer{[&] {
+      for(;;) {
+        auto const next = consumer_seq->next();
+        auto const last = sequencer.wait_for(next);
+        if(last < next)
+          break;
+        for(auto i = next; i <= last; ++i)
+          sum += buffer[i];
+        *consumer_seq = last;
+      }
+    }};
+    produce();
+    consumer.join();
+    return sum;
+  });
+
+  auto const processor = [](int64_t commit_interval) {
+    return [=](auto& buffer, auto& sequencer, auto&& produce) {
+      udisruptor::batch_event_processor<int64_t, summing_handler> processor{
+        buffer, sequencer, summing_handler{}, commit_interval};
+      std::thread consumer{[&] { processor.run(); }};
+      produce();
+      consumer.join();
+      return processor.handler().sum;
+    };
+  };
+
+  printf("Consumer loop, millions events per second - hand written %.1f, "
+         "batch_event_processor %.1f, committing every 64 events %.1f\n",
+         hand_written, run(processor(1)), run(processor(64)));
+}
+
+
+struct validating_handler {
+  int64_t checksum{0};
+
+  // Stands for a CPU-heavy stage, a few hundred nanoseconds per event
+  void operator () (int64_t& event, int64_t, bool) noexcept {
+    auto x = uint64_t(event);
+    for(auto i = 0; i != 256; ++i)
+      x = x * 6364136223846793005ull + 1442695040888963407ull;
+    checksum += int64_t(x >> 60);
+  }
+};
+
+
+void worker_pool_bench() {
+  constexpr auto events = 200000;
+  for(auto batch: {1, 64})
+    for(auto workers: {1, 2, 4}) {
+      udisruptor::ring_buffer<int64_t> buffer{4096};
+      udisruptor::multisequencer sequencer{buffer.capacity()};
+      udisruptor::worker_pool<int64_t, validating_handler, udisruptor::multisequencer> pool{
+        buffer, sequencer, workers, batch};
+      pool.start();
+      auto const started = std::chrono::steady_clock::now();
+      for(auto i = 0; i != events; ++i) {
+        auto const index = sequencer.claim();
+        buffer[index] = index;
+        sequencer.publish(index);
+      }
+      pool.halt();
+      std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - started;
+      printf("Worker pool, %d workers, batch %d - %.2f millions events per second\n",
+             workers, batch, events / elapsed.count() / 1e6);
+    }
+}
+
+
+template<typename F> double handler_group_run(F&& build) {
+  constexpr auto events = 2000000;
+  udisruptor::ring_buffer<int64_t> buffer{4096};
+  udisruptor::multisequencer sequencer{buffer.capacity()};
+  udisruptor::topology<int64_t, udisruptor::multisequencer> graph{buffer, sequencer, 64};
+  std::vector<validating_handler> handlers(4);
+  build(graph, handlers);
+  graph.start();
+  auto const started = std::chrono::steady_clock::now();
+  for(auto i = 0; i != events; ++i) {
+    auto const index = sequencer.claim();
+    buffer[index] = index;
+    sequencer.publish(index);
+  }
+  graph.halt();
+  std::chrono::duration<double> const elapsed = std::chrono::steady_clock::now() - started;
+  return events / elapsed.count() / 1e6;
+}
+
+
+void handler_group_bench() {
+  auto const single = handler_group_run([](auto& graph, auto& handlers) {
+    graph.handle_events_with(handlers[0]);
+  });
+  auto const striped = handler_group_run([](auto& graph, auto& handlers) {
+    graph.handle_events_with(udisruptor::striped(handlers));
+  });
+  auto const keyed = handler_group_run([](auto& graph, auto& handlers) {
+    graph.handle_events_with(udisruptor::by_key(handlers, [](int64_t event) {
+      return event % 1024;
+    }));
+  });
+  printf("Handler groups of 4, millions events per second - single handler %.2f, "
+         "striped %.2f, by key %.2f\n", single, striped, keyed);
+}
+
+
+int main() {
+
+  printf("Cache line - %zu bytes\n", udisruptor::sequence::cacheline);
+
+  microbench<udisruptor::sequencer>("sequencer");
+  microbench<udisruptor::multisequencer>("multisequencer");
+
+  wait_strategy_bench<udisruptor::busy_spin_wait>("busy_spin_wait");
+  wait_strategy_bench<udisruptor::yielding_wait>("yielding_wait");
+  wait_strategy_bench<udisruptor::phased_backoff_wait>("phased_backoff_wait");
+  wait_strategy_bench<udisruptor::blocking_wait>("blocking_wait");
+  wait_strategy_bench<udisruptor::parking_wait>("parking_wait");
+
+  scan_bench<udisruptor::sequence_availability>("sequence_availability");
+  scan_bench<udisruptor::lap_availability<uint32_t>>("lap_availability<uint32_t>");
+  scan_bench<udisruptor::lap_availability<uint8_t>>("lap_availability<uint8_t>");
+  scan_bench<udisruptor::parity_availability>("parity_availability");
+
+  auto const events_per_s = throughput_bench<split_layout<int64_t>>(producers_count);
   printf("Throughtput - %.0f events/second\n", events_per_s);
 
+  layout_bench<8>();
+  layout_bench<64>();
+  layout_bench<256>();
+
+  producers_bench();
+  staging_bench(4);
+  combining_bench();
+  scrambling_bench();
+  padding_bench();
+  gating_bench();
+  fixed_consumers_bench<1>();
+  fixed_consumers_bench<2>();
+  fixed_consumers_bench<4>();
+
+  cursor_bench<udisruptor::sequence_availability>("sequence_availability");
+  cursor_bench<udisruptor::cooperative_cursor<>>("cooperative_cursor");
+  cursor_bench<udisruptor::ordered_cursor<>>("ordered_cursor");
+
+  processor_bench();
+  worker_pool_bench();
+  handler_group_bench();
+
   return 0;
 }
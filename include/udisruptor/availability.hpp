@@ -0,0 +1,450 @@
+/* This file is part of udisruptor library
+ * Copyright 2020 Andrei Ilin <ortfero@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include "sequence.hpp"
+#include "slot_index.hpp"
+
+
+// Vector scans read the flags with plain loads, which ThreadSanitizer
+// reports as races with the atomic stores of producers
+#if !defined(UDISRUPTOR_NO_SIMD)
+#if defined(__SANITIZE_THREAD__)
+#define UDISRUPTOR_NO_SIMD
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define UDISRUPTOR_NO_SIMD
+#endif
+#endif
+#endif
+
+#if !defined(UDISRUPTOR_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+namespace udisruptor {
+
+
+  namespace detail {
+
+
+    inline unsigned count_trailing_zeros(uint64_t n) noexcept {
+#if defined(_MSC_VER)
+      unsigned long index;
+      _BitScanForward64(&index, n);
+      return unsigned(index);
+#else
+      return unsigned(__builtin_ctzll(n));
+#endif
+    }
+
+
+    // Policies whose publish() waits for earlier claims declare
+    // waits_to_publish and take the wait of their sequencer
+    template<typename A, typename = void>
+    struct waits_to_publish : std::false_type {};
+
+    template<typename A>
+    struct waits_to_publish<A, std::void_t<typename A::waits_to_publish>> : std::true_type {};
+
+
+  } // detail
+
+
+  // Availability policies tell multisequencer which slots are published.
+  // Ranges are marked from the top down so that consumers scanning from
+  // lo see nothing of the range until all of it is available.
+
+
+  // Stores n + 1 for each published sequence n, 8 bytes per slot
+  class sequence_availability {
+  public:
+
+    using index_type = sequence::value_type;
+    using size_type = sequence::value_type;
+
+    sequence_availability() noexcept = default;
+    sequence_availability(sequence_availability&&) noexcept = default;
+    sequence_availability& operator = (sequence_availability&&) noexcept = default;
+    explicit operator bool () const noexcept { return !!flags_; }
+
+
+    void reserve(size_type capacity) {
+      flags_ = std::make_unique<std::atomic<index_type>[]>(capacity);
+      for(size_type n = 0; n != capacity; ++n)
+        flags_[n].store(0, std::memory_order_relaxed);
+      index_mask_ = index_type(capacity - 1);
+    }
+
+
+    void publish(index_type n) noexcept {
+      flags_[n & index_mask_].store(n + 1, std::memory_order_release);
+    }
+
+
+    void publish(index_type lo, index_type hi) noexcept {
+      for(index_type n = hi; n >= lo; --n)
+        publish(n);
+    }
+
+
+    bool published(index_type n) const noexcept {
+      return flags_[n & index_mask_].load(std::memory_order_acquire) == n + 1;
+    }
+
+
+    // Returns the first sequence not published starting from n
+    index_type scan(index_type n) const noexcept {
+#if !defined(UDISRUPTOR_NO_SIMD) && (defined(__AVX2__) || defined(__SSE4_1__))
+      static_assert(sizeof(std::atomic<index_type>) == sizeof(index_type));
+      auto const flags = reinterpret_cast<index_type const*>(flags_.get());
+      auto const first = n;
+      for(;;) {
+        auto const slot = n & index_mask_;
+#if defined(__AVX2__)
+        if(slot + 4 <= index_mask_ + 1) {
+          auto const expected = _mm256_set_epi64x(n + 4, n + 3, n + 2, n + 1);
+          auto const actual = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(flags + slot));
+          auto const equal = unsigned(_mm256_movemask_pd(
+            _mm256_castsi256_pd(_mm256_cmpeq_epi64(actual, expected))));
+          if(equal == 0xF) {
+            n += 4;
+            continue;
+          }
+          n += detail::count_trailing_zeros(~equal);
+          break;
+        }
+#else
+        if(slot + 2 <= index_mask_ + 1) {
+          auto const expected = _mm_set_epi64x(n + 2, n + 1);
+          auto const actual = _mm_loadu_si128(reinterpret_cast<__m128i const*>(flags + slot));
+          auto const equal = unsigned(_mm_movemask_pd(
+            _mm_castsi128_pd(_mm_cmpeq_epi64(actual, expected))));
+          if(equal == 0x3) {
+            n += 2;
+            continue;
+          }
+          n += detail::count_trailing_zeros(~equal);
+          break;
+        }
+#endif
+        if(flags_[slot].load(std::memory_order_relaxed) != n + 1)
+          break;
+        ++n;
+      }
+      if(n != first)
+        std::atomic_thread_fence(std::memory_order_acquire);
+      return n;
+#else
+      while(published(n))
+        ++n;
+      return n;
+#endif
+    }
+
+  private:
+
+    index_type index_mask_{0};
+    std::unique_ptr<std::atomic<index_type>[]> flags_;
+
+  }; // sequence_availability
+
+
+  // Keeps n + 1 like sequence_availability, but in scrambled_index order
+  // so producers of consecutive sequences do not share a cache line.
+  // Pair it with a ring_buffer<T, scrambled_index<sizeof(T)>>.
+  class scrambled_availability {
+  public:
+
+    using index_type = sequence::value_type;
+    using size_type = sequence::value_type;
+
+    scrambled_availability() noexcept = default;
+    scrambled_availability(scrambled_availability&&) noexcept = default;
+    scrambled_availability& operator = (scrambled_availability&&) noexcept = default;
+    explicit operator bool () const noexcept { return !!flags_; }
+
+
+    void reserve(size_type capacity) {
+      flags_ = std::make_unique<std::atomic<index_type>[]>(capacity);
+      for(size_type n = 0; n != capacity; ++n)
+        flags_[n].store(0, std::memory_order_relaxed);
+      index_.reserve(capacity);
+    }
+
+
+    void publish(index_type n) noexcept {
+      flags_[index_(n)].store(n + 1, std::memory_order_release);
+    }
+
+
+    void publish(index_type lo, index_type hi) noexcept {
+      for(index_type n = hi; n >= lo; --n)
+        publish(n);
+    }
+
+
+    bool published(index_type n) const noexcept {
+      return flags_[index_(n)].load(std::memory_order_acquire) == n + 1;
+    }
+
+
+    index_type scan(index_type n) const noexcept {
+      while(published(n))
+        ++n;
+      return n;
+    }
+
+  private:
+
+    scrambled_index<sizeof(index_type)> index_;
+    std::unique_ptr<std::atomic<index_type>[]> flags_;
+
+  }; // scrambled_availability
+
+
+  // Stores the lap number of each published sequence truncated to T, so
+  // uint32_t takes 4 bytes per slot and uint8_t takes 1 byte
+  template<typename T>
+  class lap_availability {
+  public:
+
+    using index_type = sequence::value_type;
+    using size_type = sequence::value_type;
+    using flag_type = T;
+
+    lap_availability() noexcept = default;
+    lap_availability(lap_availability&&) noexcept = default;
+    lap_availability& operator = (lap_availability&&) noexcept = default;
+    explicit operator bool () const noexcept { return !!flags_; }
+
+
+    void reserve(size_type capacity) {
+      flags_ = std::make_unique<std::atomic<T>[]>(capacity);
+      for(size_type n = 0; n != capacity; ++n)
+        flags_[n].store(T(-1), std::memory_order_relaxed);
+      index_mask_ = index_type(capacity - 1);
+      index_shift_ = 0;
+      while((size_type(1) << index_shift_) != capacity)
+        ++index_shift_;
+    }
+
+
+    void publish(index_type n) noexcept {
+      flags_[n & index_mask_].store(lap(n), std::memory_order_release);
+    }
+
+
+    void publish(index_type lo, index_type hi) noexcept {
+      for(index_type n = hi; n >= lo; --n)
+        publish(n);
+    }
+
+
+    bool published(index_type n) const noexcept {
+      return flags_[n & index_mask_].load(std::memory_order_acquire) == lap(n);
+    }
+
+
+    // Flags of a lap are compared against its number a vector at a time
+    index_type scan(index_type n) const noexcept {
+#if !defined(UDISRUPTOR_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+      static_assert(sizeof(T) == 1 || sizeof(T) == 4);
+      static_assert(sizeof(std::atomic<T>) == sizeof(T));
+      auto const flags = reinterpret_cast<T const*>(flags_.get());
+      auto const first = n;
+      for(;;) {
+        auto const slot = n & index_mask_;
+#if defined(__AVX2__)
+        constexpr index_type lanes = 32 / sizeof(T);
+        if(slot + lanes <= index_mask_ + 1) {
+          auto const expected = sizeof(T) == 1
+            ? _mm256_set1_epi8(char(lap(n)))
+            : _mm256_set1_epi32(int(lap(n)));
+          auto const actual = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(flags + slot));
+          auto const equal = unsigned(_mm256_movemask_epi8(sizeof(T) == 1
+            ? _mm256_cmpeq_epi8(actual, expected)
+            : _mm256_cmpeq_epi32(actual, expected)));
+          if(equal == 0xFFFFFFFFu) {
+            n += lanes;
+            continue;
+          }
+          n += detail::count_trailing_zeros(~equal) / sizeof(T);
+          break;
+        }
+#else
+        constexpr index_type lanes = 16 / sizeof(T);
+        if(slot + lanes <= index_mask_ + 1) {
+          auto const expected = sizeof(T) == 1
+            ? _mm_set1_epi8(char(lap(n)))
+            : _mm_set1_epi32(int(lap(n)));
+          auto const actual = _mm_loadu_si128(reinterpret_cast<__m128i const*>(flags + slot));
+          auto const equal = unsigned(_mm_movemask_epi8(sizeof(T) == 1
+            ? _mm_cmpeq_epi8(actual, expected)
+            : _mm_cmpeq_epi32(actual, expected)));
+          if(equal == 0xFFFFu) {
+            n += lanes;
+            continue;
+          }
+          n += detail::count_trailing_zeros(~equal) / sizeof(T);
+          break;
+        }
+#endif
+        if(flags_[slot].load(std::memory_order_relaxed) != lap(n))
+          break;
+        ++n;
+      }
+      if(n != first)
+        std::atomic_thread_fence(std::memory_order_acquire);
+      return n;
+#else
+      while(published(n))
+        ++n;
+      return n;
+#endif
+    }
+
+  private:
+
+    index_type index_mask_{0};
+    unsigned index_shift_{0};
+    std::unique_ptr<std::atomic<T>[]> flags_;
+
+
+    T lap(index_type n) const noexcept {
+      return T(n >> index_shift_);
+    }
+
+  }; // lap_availability
+
+
+  // Stores the parity of the lap number, 1 bit per slot. Producers
+  // publish with an atomic RMW on a word shared by 64 slots, so this one
+  // trades producer contention for the smallest consumer footprint.
+  class parity_availability {
+  public:
+
+    using index_type = sequence::value_type;
+    using size_type = sequence::value_type;
+
+    parity_availability() noexcept = default;
+    parity_availability(parity_availability&&) noexcept = default;
+    parity_availability& operator = (parity_availability&&) noexcept = default;
+    explicit operator bool () const noexcept { return !!words_; }
+
+
+    void reserve(size_type capacity) {
+      auto const words_count = (capacity + word_bits - 1) / word_bits;
+      words_ = std::make_unique<std::atomic<uint64_t>[]>(words_count);
+      for(size_type n = 0; n != words_count; ++n)
+        words_[n].store(~uint64_t(0), std::memory_order_relaxed);
+      index_mask_ = index_type(capacity - 1);
+      index_shift_ = 0;
+      while((size_type(1) << index_shift_) != capacity)
+        ++index_shift_;
+    }
+
+
+    void publish(index_type n) noexcept {
+      mark(n & index_mask_, uint64_t(1) << (n & index_mask_ & (word_bits - 1)), parity(n));
+    }
+
+
+    // Marks the slots of each word with a single RMW
+    void publish(index_type lo, index_type hi) noexcept {
+      for(index_type n = hi; n >= lo;) {
+        auto const slot = n & index_mask_;
+        auto const bit = slot & (word_bits - 1);
+        auto const first = n - bit > lo ? n - bit : lo;
+        auto const first_bit = first & index_mask_ & (word_bits - 1);
+        auto const bits = (bit == word_bits - 1 ? ~uint64_t(0) : (uint64_t(2) << bit) - 1)
+          & ~((uint64_t(1) << first_bit) - 1);
+        mark(slot, bits, parity(n));
+        n = first - 1;
+      }
+    }
+
+
+    bool published(index_type n) const noexcept {
+      auto const slot = n & index_mask_;
+      auto const word = words_[slot / word_bits].load(std::memory_order_acquire);
+      return ((word >> (slot & (word_bits - 1))) & 1) == parity(n);
+    }
+
+
+    // Checks up to 64 slots per word load
+    index_type scan(index_type n) const noexcept {
+      auto const capacity = index_mask_ + 1;
+      auto const bits_used = capacity < word_bits ? capacity : word_bits;
+      for(;;) {
+        auto const slot = n & index_mask_;
+        auto const bit = slot & (word_bits - 1);
+        auto const word = words_[slot / word_bits].load(std::memory_order_acquire);
+        auto const expected = parity(n) ? ~uint64_t(0) : uint64_t(0);
+        auto const count = bits_used - bit;
+        auto unpublished = (word ^ expected) >> bit;
+        if(count != word_bits)
+          unpublished &= (uint64_t(1) << count) - 1;
+        if(unpublished != 0)
+          return n + detail::count_trailing_zeros(unpublished);
+        n += count;
+      }
+    }
+
+  private:
+
+    static constexpr index_type word_bits = 64;
+
+    index_type index_mask_{0};
+    unsigned index_shift_{0};
+    std::unique_ptr<std::atomic<uint64_t>[]> words_;
+
+
+    uint64_t parity(index_type n) const noexcept {
+      return uint64_t(n >> index_shift_) & 1;
+    }
+
+
+    void mark(index_type slot, uint64_t bits, uint64_t parity) noexcept {
+      auto& word = words_[slot / word_bits];
+      if(parity)
+        word.fetch_or(bits, std::memory_order_release);
+      else
+        word.fetch_and(~bits, std::memory_order_release);
+    }
+
+  }; // parity_availability
+
+
+} // udisruptor
@@ -23,66 +23,130 @@
 #pragma once
 
 
+#include <atomic>
 #include <cstddef>
-#include <vector>
-#include <limits>
-#include <thread>
 #include "sequence.hpp"
+#include "sequence_set.hpp"
+#include "wait_strategy.hpp"
 
 
 namespace udisruptor {
   
 
-  class barrier {
+  // N is the number of dependencies if known at compile time, 0 otherwise
+  template<typename W, std::size_t N = 0>
+  class basic_barrier {
   public:
   
     using index_type = sequence::value_type;
     using size_type = sequence::value_type;
+    using wait_strategy_type = W;
   
-    barrier() noexcept = default;
-    barrier(barrier const&) = default;
-    barrier& operator = (barrier const&) = default;
-    barrier(barrier&&) noexcept = default;
-    barrier& operator = (barrier&&) noexcept = default;
+    basic_barrier() noexcept = default;
+
+
+    basic_barrier(basic_barrier const& other):
+      dependencies_{other.dependencies_},
+      wait_strategy_{other.wait_strategy_},
+      state_{other.state_.load()}
+    { }
+
+
+    basic_barrier& operator = (basic_barrier const& other) {
+      dependencies_ = other.dependencies_;
+      wait_strategy_ = other.wait_strategy_;
+      state_.store(other.state_.load());
+      return *this;
+    }
+
+
+    explicit basic_barrier(W wait_strategy) noexcept:
+      wait_strategy_{std::move(wait_strategy)}
+    { }
     
     
-    void depends_on(sequence const& n) {
-      dependencies_.push_back(&n);
+    // Returns false when all N dependencies are added
+    bool depends_on(sequence const& n) {
+      return dependencies_.add(n);
     }
     
     
+    // Returns the last available sequence or sequence::alerted
     index_type wait(index_type n) {
-      
-      auto last_value = std::numeric_limits<index_type>::max();
-      sequence const* last_sequence = nullptr;
-      
-      for(auto dependency: dependencies_) {
-        auto const m = dependency->value();
-        if(m >= last_value)
-          continue;
-        last_value = m;
-        last_sequence = dependency;
-      }
-      
-      if(last_sequence == nullptr)
+
+      if(state_.load(std::memory_order_relaxed) == state_alerted)
+        return sequence::alerted;
+
+      if(dependencies_.empty())
         return n;
       
+      auto last_value = minimum_dependency();
       if(n <= last_value)
         return last_value;
-      
-      do {
-        std::this_thread::yield();
-        last_value = last_sequence->value();
-      } while(n > last_value);
+
+      wait_strategy_.wait([&] {
+        last_value = minimum_dependency();
+        return n <= last_value
+          || state_.load(std::memory_order_relaxed) != state_running;
+      });
+
+      if(n > last_value || state_.load(std::memory_order_relaxed) == state_alerted)
+        return sequence::alerted;
 
       return last_value;
-    }  
+    }
+
+
+    // Highest index every dependency reached, without waiting
+    index_type available() const noexcept {
+      return minimum_dependency();
+    }
+
+
+    // Wakes threads blocked in wait() after a dependency was advanced
+    void notify() {
+      wait_strategy_.notify();
+    }
+
+
+    // wait() returns sequence::alerted at once
+    void alert() {
+      state_.store(state_alerted, std::memory_order_seq_cst);
+      wait_strategy_.notify();
+    }
+
+
+    // wait() returns what dependencies reached and sequence::alerted
+    // only when it would block
+    void halt() {
+      state_.store(state_halted, std::memory_order_seq_cst);
+      wait_strategy_.notify();
+    }
+
+
+    void resume() noexcept {
+      state_.store(state_running, std::memory_order_release);
+    }
   
   private:
+
+    enum state : int {
+      state_running, state_halted, state_alerted
+    };
   
-    std::vector<sequence const*> dependencies_;
+    dependency_set<N> dependencies_;
+    W wait_strategy_;
+    std::atomic<int> state_{state_running};
+
+
+    index_type minimum_dependency() const noexcept {
+      return dependencies_.minimum();
+    }
     
-  }; // barrier
+  }; // basic_barrier
+
+
+  using barrier = basic_barrier<yielding_wait>;
   
   
 } // udisruptor
@@ -23,37 +23,77 @@
 #pragma once
 
 
+#include <atomic>
 #include <vector>
 #include <thread>
 #include <memory>
+#include <chrono>
 #include "sequence.hpp"
+#include "wait_strategy.hpp"
+#include "notifier.hpp"
+#include "sequence_set.hpp"
 
 
 
 namespace udisruptor {
   
   
+  // N is the number of consumers if known at compile time, 0 otherwise
+  template<typename W, std::size_t N = 0>
   class base_sequencer {
   public:
   
     using index_type = sequence::value_type;
     using size_type = sequence::value_type;
+    using wait_strategy_type = W;
+
+    // Consumers known at compile time, 0 when they come and go
+    static constexpr std::size_t fixed_consumers = N;
     
     base_sequencer() noexcept = default;
     base_sequencer(base_sequencer const&) = delete;
     base_sequencer& operator = (base_sequencer const&) = delete;
-    base_sequencer(base_sequencer&& other) noexcept = default;
-    base_sequencer& operator = (base_sequencer&& other) noexcept = default;
 
 
-    sequence* add_consumer() {
-      consumers_.emplace_back(sequence{});
-      return &consumers_.back();
+    base_sequencer(base_sequencer&& other) noexcept:
+      capacity_{other.capacity_},
+      consumers_{std::move(other.consumers_)},
+      notifiers_{std::move(other.notifiers_)},
+      state_{other.state_.load()},
+      gating_wait_{std::move(other.gating_wait_)},
+      publish_wait_{std::move(other.publish_wait_)}
+    { }
+
+
+    base_sequencer& operator = (base_sequencer&& other) noexcept {
+      capacity_ = other.capacity_;
+      consumers_ = std::move(other.consumers_);
+      notifiers_ = std::move(other.notifiers_);
+      state_.store(other.state_.load());
+      gating_wait_ = std::move(other.gating_wait_);
+      publish_wait_ = std::move(other.publish_wait_);
+      return *this;
+    }
+
+
+    // Stops gating producers on consumer, which may be freed on return.
+    // Returns false if it is not an active consumer or N is fixed.
+    bool remove_consumer(sequence const* consumer) {
+      if(!consumers_.remove(consumer))
+        return false;
+      // The removed consumer may have been the one producers wait for
+      notify_consumed();
+      return true;
+    }
+
+
+    void add_notifier(notifier& n) {
+      notifiers_.push_back(&n);
     }
 
 
     explicit operator bool () noexcept {
-      return capacity_ != 0 && !consumers_.empty();
+      return capacity_ != 0 && consumers_.ready();
     }
 
 
@@ -61,49 +101,200 @@ namespace udisruptor {
       capacity_ = nearest_power_of_2(capacity);
     }
 
+
+    // Advances consumer and wakes producers parked on a full ring
+    void commit(sequence& consumer, index_type n) {
+      consumer = n;
+      notify_consumed();
+    }
+
+
+    // Wakes producers parked on a full ring after consumers advanced
+    void notify_consumed() {
+      gating_wait_.notify();
+    }
+
+
+    // Every wait returns sequence::alerted at once
+    void alert() {
+      stop(state_alerted);
+    }
+
+
+    // Claims return sequence::alerted, consumers still receive everything
+    // published so far and get sequence::alerted once they drained it
+    void halt() {
+      stop(state_halted);
+    }
+
+
+    void resume() noexcept {
+      state_.store(state_running, std::memory_order_release);
+    }
+
+
+    bool halted() const noexcept {
+      return state_.load(std::memory_order_relaxed) != state_running;
+    }
+
     
   protected:
-  
+
+    explicit base_sequencer(W const& wait_strategy) noexcept:
+      gating_wait_{wait_strategy},
+      publish_wait_{wait_strategy}
+    { }
+
+
     size_type capacity() const noexcept {
       return capacity_;
     }
+
+
+    // Returns nullptr when all N consumers are added
+    template<typename F> sequence* add_consumer(F&& cursor) {
+      auto const consumer = consumers_.add(std::forward<F>(cursor));
+      // Producers parked before the consumer joined re-check the minimum
+      if(consumer != nullptr)
+        notify_consumed();
+      return consumer;
+    }
+
+
+    // Returns false when N is fixed
+    template<typename F> bool add_consumer(sequence& consumer, F&& cursor) {
+      if(!consumers_.add(consumer, std::forward<F>(cursor)))
+        return false;
+      notify_consumed();
+      return true;
+    }
+
+
+    bool alerted() const noexcept {
+      return state_.load(std::memory_order_relaxed) == state_alerted;
+    }
       
 
-    index_type wait(index_type n) {
+    // Gating checks take the producer's bound on consumers, a plain
+    // index_type when one thread owns it or a sequence when it is shared,
+    // and the cursor producers gate on while no consumer is active
+
+
+    // Returns n or sequence::alerted
+    template<typename C, typename F>
+    index_type wait(index_type n, C& cached_last, F&& cursor) {
 
-      if(n - cached_last_.value() < capacity_)
+      if(n - cached(cached_last) <= capacity_)
         return n;
 
-      index_type last_value = consumers_.front().value();
-      sequence const* last_sequence = &consumers_.front();
-
-      if(consumers_.size() > 1) {
-        for(auto it = consumers_.begin() + 1; it != consumers_.end(); ++it) {
-          auto const m = it->value();
-          if(m >= last_value)
-            continue;
-          last_value = m;
-          last_sequence = &*it;
-        }
+      auto last_value = consumers_.minimum(cursor);
+      if(n - last_value > capacity_) {
+        gating_wait_.wait([&] {
+          last_value = consumers_.minimum(cursor);
+          return n - last_value <= capacity_ || halted();
+        });
+        if(n - last_value > capacity_)
+          return sequence::alerted;
       }
-      
-      while(n - last_value >= capacity_) {
-        std::this_thread::yield();
-        last_value = last_sequence->value();
+
+      cache(cached_last, last_value);
+
+      return n;
+    }
+
+
+    template<typename C, typename F>
+    bool available(index_type n, C& cached_last, F&& cursor) noexcept {
+
+      if(n - cached(cached_last) <= capacity_)
+        return true;
+
+      auto const last_value = consumers_.minimum(cursor);
+      cache(cached_last, last_value);
+
+      return n - last_value <= capacity_;
+    }
+
+
+    // Returns n, sequence::invalid on timeout or sequence::alerted
+    template<typename C, typename F, typename Clock, typename Duration>
+    index_type wait_until(index_type n,
+                          std::chrono::time_point<Clock, Duration> const& deadline,
+                          C& cached_last, F&& cursor) {
+
+      if(n - cached(cached_last) <= capacity_)
+        return n;
+
+      auto last_value = consumers_.minimum(cursor);
+      if(n - last_value > capacity_) {
+        auto const ready = gating_wait_.wait_until([&] {
+          last_value = consumers_.minimum(cursor);
+          return n - last_value <= capacity_ || halted();
+        }, deadline);
+        if(!ready)
+          return sequence::invalid;
+        if(n - last_value > capacity_)
+          return sequence::alerted;
       }
 
-      cached_last_ = last_value;
+      cache(cached_last, last_value);
 
       return n;
-    }      
+    }
+
+
+    template<typename F> void wait_published(F&& ready) {
+      publish_wait_.wait([&] { return ready() || halted(); });
+    }
+
+
+    // Returns false if alerted first. A halt keeps waiting, so that what
+    // was claimed before it still gets published.
+    template<typename F> bool wait_unless_alerted(F&& ready) {
+      publish_wait_.wait([&] { return ready() || alerted(); });
+      return ready();
+    }
+
+
+    void notify_published() {
+      publish_wait_.notify();
+      if(notifiers_.empty())
+        return;
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      for(auto n: notifiers_)
+        n->notify();
+    }
 
 
   private:
+
+    enum state : int {
+      state_running, state_halted, state_alerted
+    };
   
+    // Read mostly by both sides
     size_type capacity_{0};
-    std::vector<sequence> consumers_;
-    sequence cached_last_;
-    
+    consumer_set<N> consumers_;
+    std::vector<notifier*> notifiers_;
+    std::atomic<int> state_{state_running};
+
+    // Written by waiters of one side and notifiers of the other
+    alignas(sequence::cacheline) W gating_wait_;
+    alignas(sequence::cacheline) W publish_wait_;
+
+
+    void stop(state s) {
+      state_.store(s, std::memory_order_seq_cst);
+      gating_wait_.notify();
+      notify_published();
+    }
+
+
+    static index_type cached(index_type n) noexcept { return n; }
+    static index_type cached(sequence const& n) noexcept { return n.value(); }
+    static void cache(index_type& n, index_type value) noexcept { n = value; }
+    static void cache(sequence& n, index_type value) noexcept { n.lazy_store(value); }
+
 
     static uint64_t nearest_power_of_2(uint64_t n) {
       if(n < 2)
@@ -0,0 +1,221 @@
+/* This file is part of udisruptor library
+ * Copyright 2020 Andrei Ilin <ortfero@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+
+#include <utility>
+#include <vector>
+#include "ring_buffer.hpp"
+#include "sequence.hpp"
+#include "sequencer.hpp"
+#include "barrier.hpp"
+
+
+namespace udisruptor {
+
+
+  // Partition of a processor which handles every event
+  struct every_event {
+
+    using index_type = sequence::value_type;
+    using size_type = sequence::value_type;
+
+    template<typename B, typename H>
+    size_type handle(B& buffer, index_type first, index_type last, H& handler) {
+      for(auto i = first; i != last; ++i)
+        handler(buffer[i], i, false);
+      handler(buffer[last], last, true);
+      return last - first + 1;
+    }
+
+  }; // every_event
+
+
+  // Consumer loop of one thread. Calls handler(T&, index, end_of_batch)
+  // for every event it handles, end_of_batch being true for the last one
+  // of what was available,
+  // and commits its sequence once commit_interval events are handled or
+  // before it has to wait. Events are taken from the sequencer S or, after
+  // other processors, from a barrier G depending on them. P selects the
+  // events this processor handles, see handler_group.hpp. Producers gate
+  // on the processor while it is registered with the sequencer.
+  template<typename T, typename H, typename S = sequencer, typename G = S,
+           typename P = every_event>
+  class batch_event_processor {
+  public:
+
+    using index_type = sequence::value_type;
+    using size_type = sequence::value_type;
+    using handler_type = H;
+    using barrier_type = basic_barrier<typename S::wait_strategy_type>;
+
+    static_assert(S::fixed_consumers == 0,
+                  "processors register sequences of their own, "
+                  "which fixed consumer sets can't gate on");
+
+    batch_event_processor(batch_event_processor const&) = delete;
+    batch_event_processor& operator = (batch_event_processor const&) = delete;
+
+
+    batch_event_processor(ring_buffer<T>& buffer, S& sequencer, H handler = H{},
+                          size_type commit_interval = 1):
+      batch_event_processor{buffer, sequencer, sequencer, std::move(handler),
+                            commit_interval}
+    { }
+
+
+    batch_event_processor(ring_buffer<T>& buffer, S& sequencer, G& gate,
+                          H handler = H{}, size_type commit_interval = 1,
+                          P partition = P{}):
+      buffer_{&buffer},
+      sequencer_{&sequencer},
+      gate_{&gate},
+      handler_{std::move(handler)},
+      partition_{std::move(partition)},
+      commit_interval_{commit_interval < 1 ? 1 : commit_interval},
+      registered_{sequencer.add_consumer(consumer_)} {
+      next_ = committed_ = consumer_.value() + 1;
+    }
+
+
+    ~batch_event_processor() {
+      sequencer_->remove_consumer(&consumer_);
+    }
+
+
+    // False if the sequencer refused to gate on the processor
+    explicit operator bool () const noexcept {
+      return registered_;
+    }
+
+
+    // Handles events until the gate is halted and drained or alerted.
+    // Returns the number of events handled.
+    size_type run() {
+      size_type handled = 0;
+      for(;;) {
+        auto last = available(*gate_, next_);
+        if(last < next_) {
+          commit();
+          last = wait(*gate_, next_);
+          if(last < next_)
+            break;
+        }
+        handled += handle(last);
+      }
+      commit();
+      return handled;
+    }
+
+
+    // Handles what is available without waiting
+    size_type poll() {
+      auto const last = available(*gate_, next_);
+      if(last < next_) {
+        commit();
+        return 0;
+      }
+      return handle(last);
+    }
+
+
+    // Barrier of processors after this one, woken on every commit
+    void notifies(barrier_type& dependent) {
+      dependents_.push_back(&dependent);
+    }
+
+
+    sequence const& position() const noexcept {
+      return consumer_;
+    }
+
+
+    H& handler() noexcept {
+      return handler_;
+    }
+
+
+    H const& handler() const noexcept {
+      return handler_;
+    }
+
+  private:
+
+    sequence consumer_;
+    ring_buffer<T>* buffer_;
+    S* sequencer_;
+    G* gate_;
+    H handler_;
+    P partition_;
+    size_type commit_interval_;
+    bool registered_;
+    index_type next_{0};
+    index_type committed_{0};
+    std::vector<barrier_type*> dependents_;
+
+
+    // Events the partition skips are committed as well
+    size_type handle(index_type last) {
+      auto const handled = partition_.handle(*buffer_, next_, last, handler_);
+      next_ = last + 1;
+      if(next_ - committed_ >= commit_interval_)
+        commit();
+      return handled;
+    }
+
+
+    void commit() {
+      if(committed_ == next_)
+        return;
+      sequencer_->commit(consumer_, next_ - 1);
+      committed_ = next_;
+      for(auto dependent: dependents_)
+        dependent->notify();
+    }
+
+
+    template<typename Q> static index_type available(Q& s, index_type n) {
+      return s.try_fetch_all(n) - 1;
+    }
+
+
+    template<typename W, std::size_t M>
+    static index_type available(basic_barrier<W, M>& b, index_type) noexcept {
+      return b.available();
+    }
+
+
+    template<typename Q> static index_type wait(Q& s, index_type n) {
+      return s.wait_for(n);
+    }
+
+
+    template<typename W, std::size_t M>
+    static index_type wait(basic_barrier<W, M>& b, index_type n) {
+      return b.wait(n);
+    }
+
+  }; // batch_event_processor
+
+
+} // udisruptor
@@ -0,0 +1,207 @@
+/* This file is part of udisruptor library
+ * Copyright 2020 Andrei Ilin <ortfero@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <atomic>
+#include <memory>
+#include "sequence.hpp"
+#include "wait_strategy.hpp"
+
+
+namespace udisruptor {
+
+
+  // Flat-combining claims for a multisequencer S. Producers post requests
+  // to their own slots, and whichever of them takes the combiner lock
+  // gates and claims for everybody with one CAS and hands out sub-ranges.
+  // A request which is not served within spins is withdrawn and claimed
+  // like S::claim(). Claims are lock-free but not wait-free: a producer
+  // whose request a combiner took waits until that combiner serves it or
+  // hands it back, also while the combiner is descheduled.
+  template<typename S>
+  class claim_combiner {
+  public:
+
+    using index_type = sequence::value_type;
+    using size_type = sequence::value_type;
+
+    class producer {
+    public:
+
+      producer() noexcept = default;
+
+
+      index_type claim() noexcept {
+        return combiner_->claim(1, slot_, cached_last_);
+      }
+
+
+      index_type claim(size_type n) noexcept {
+        return combiner_->claim(n, slot_, cached_last_);
+      }
+
+
+      void publish(index_type n) noexcept {
+        combiner_->sequencer_->publish(n);
+      }
+
+
+      void publish(index_type lo, index_type hi) noexcept {
+        combiner_->sequencer_->publish(lo, hi);
+      }
+
+    private:
+
+      friend class claim_combiner;
+
+      claim_combiner* combiner_{nullptr};
+      size_type slot_{0};
+      index_type cached_last_{sequence::invalid};
+
+    }; // producer
+
+
+    claim_combiner(claim_combiner const&) = delete;
+    claim_combiner& operator = (claim_combiner const&) = delete;
+
+
+    claim_combiner(S& sequencer, size_type producers, unsigned spins = 256):
+      sequencer_{&sequencer},
+      slots_{std::make_unique<slot[]>(producers)},
+      slots_count_{producers},
+      spins_{spins}
+    { }
+
+
+    // Handle for a single producer thread, producers beyond the number
+    // of slots claim with plain fetch_add
+    producer add_producer() noexcept {
+      producer p;
+      p.combiner_ = this;
+      p.slot_ = registered_.fetch_add(1, std::memory_order_relaxed);
+      return p;
+    }
+
+  private:
+
+    enum request : index_type {
+      request_idle = 0, request_served = -1, request_taken = -2
+    };
+
+    struct slot {
+      alignas(sequence::cacheline) std::atomic<index_type> request{request_idle};
+      index_type first{0};
+      size_type size{0};
+    };
+
+    S* sequencer_;
+    std::unique_ptr<slot[]> slots_;
+    size_type slots_count_;
+    unsigned spins_;
+    std::atomic<size_type> registered_{0};
+    alignas(sequence::cacheline) std::atomic<bool> combining_{false};
+
+
+    index_type claim(size_type n, size_type slot_index, index_type& cached_last) noexcept {
+      if(!sequencer_->published_ || n < 1 || n > sequencer_->capacity())
+        return sequence::invalid;
+      if(sequencer_->halted())
+        return sequence::alerted;
+      if(slot_index >= slots_count_)
+        return sequencer_->claim(n, cached_last);
+      return combine(n, slots_[slot_index], cached_last);
+    }
+
+
+    index_type combine(size_type n, slot& own, index_type& cached_last) noexcept {
+      own.request.store(n, std::memory_order_release);
+      for(unsigned i = 0; i != spins_; ++i) {
+        if(!combining_.load(std::memory_order_relaxed)
+           && !combining_.exchange(true, std::memory_order_acquire)) {
+          serve(cached_last);
+          combining_.store(false, std::memory_order_release);
+        }
+        if(own.request.load(std::memory_order_acquire) == request_served)
+          return take(own);
+        detail::spin_pause();
+      }
+      for(;;) {
+        index_type expected = n;
+        if(own.request.compare_exchange_strong(expected, request_idle,
+                                               std::memory_order_acquire))
+          return sequencer_->claim(n, cached_last);
+        if(expected == request_served)
+          return take(own);
+        detail::spin_pause();
+      }
+    }
+
+
+    index_type take(slot& own) noexcept {
+      own.request.store(request_idle, std::memory_order_relaxed);
+      return own.first;
+    }
+
+
+    // Gates the whole batch before claiming it. Requests go back to their
+    // producers when the ring is full, so they wait for room themselves.
+    void serve(index_type& cached_last) noexcept {
+      auto const registered = registered_.load(std::memory_order_relaxed);
+      auto const slots_count = registered < slots_count_ ? registered : slots_count_;
+      size_type total = 0;
+      for(size_type i = 0; i != slots_count; ++i) {
+        auto& s = slots_[i];
+        auto n = s.request.load(std::memory_order_acquire);
+        if(n <= 0 || !s.request.compare_exchange_strong(n, request_taken,
+                                                         std::memory_order_acquire))
+          continue;
+        s.size = n;
+        s.first = total;
+        total += n;
+      }
+      if(total == 0)
+        return;
+      auto first = sequencer_->producer_.load();
+      auto claimed = false;
+      while(!claimed && sequencer_->available(first + total - 1, cached_last,
+                                              sequencer_->consumer_cursor()))
+        claimed = sequencer_->producer_.compare_exchange_weak(first, first + total);
+      for(size_type i = 0; i != slots_count; ++i) {
+        auto& s = slots_[i];
+        if(s.request.load(std::memory_order_relaxed) != request_taken)
+          continue;
+        if(!claimed) {
+          s.request.store(s.size, std::memory_order_relaxed);
+          continue;
+        }
+        s.first += first;
+        s.request.store(request_served, std::memory_order_release);
+      }
+    }
+
+  }; // claim_combiner
+
+
+} // udisruptor
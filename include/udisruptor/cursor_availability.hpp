@@ -0,0 +1,184 @@
+/* This file is part of udisruptor library
+ * Copyright 2020 Andrei Ilin <ortfero@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <atomic>
+#include <type_traits>
+#include "sequence.hpp"
+#include "availability.hpp"
+#include "wait_strategy.hpp"
+
+
+namespace udisruptor {
+
+
+  // Availability policies which keep the highest contiguously published
+  // index in a single cursor. Consumers and barriers gate on cursor()
+  // instead of scanning per-slot flags.
+
+
+  // Producers mark their slots in A and then move the cursor past every
+  // contiguous slot they find, including slots published by others
+  template<typename A = sequence_availability>
+  class cooperative_cursor {
+  public:
+
+    using index_type = sequence::value_type;
+    using size_type = sequence::value_type;
+
+    cooperative_cursor() noexcept = default;
+    cooperative_cursor(cooperative_cursor&&) noexcept = default;
+    cooperative_cursor& operator = (cooperative_cursor&&) noexcept = default;
+    explicit operator bool () const noexcept { return !!slots_; }
+
+
+    void reserve(size_type capacity) {
+      slots_.reserve(capacity);
+    }
+
+
+    void publish(index_type n) noexcept {
+      slots_.publish(n);
+      advance();
+    }
+
+
+    void publish(index_type lo, index_type hi) noexcept {
+      slots_.publish(lo, hi);
+      advance();
+    }
+
+
+    bool published(index_type n) const noexcept {
+      return n <= cursor_.value();
+    }
+
+
+    index_type scan(index_type n) const noexcept {
+      auto const last = cursor_.value();
+      return n <= last ? last + 1 : n;
+    }
+
+
+    sequence const& cursor() const noexcept {
+      return cursor_;
+    }
+
+  private:
+
+    sequence cursor_;
+    A slots_;
+
+
+    void advance() noexcept {
+      // Either this producer sees the slot of a concurrent one or the
+      // other way round, so the cursor never stalls behind a published slot
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      auto last = cursor_.value();
+      for(;;) {
+        auto const until = slots_.scan(last + 1) - 1;
+        if(until == last)
+          return;
+        if(cursor_.compare_exchange(last, until))
+          last = until;
+      }
+    }
+
+  }; // cooperative_cursor
+
+
+  // Producers publish in claim order: each one waits until the cursor
+  // reaches its first slot, with the wait of its multisequencer or with W
+  // on its own. A producer that claimed and does not publish stalls later
+  // ones until alert().
+  template<typename W = yielding_wait>
+  class ordered_cursor {
+  public:
+
+    using index_type = sequence::value_type;
+    using size_type = sequence::value_type;
+    using waits_to_publish = std::true_type;
+
+    ordered_cursor() noexcept = default;
+    ordered_cursor(ordered_cursor&&) noexcept = default;
+    ordered_cursor& operator = (ordered_cursor&&) noexcept = default;
+    explicit operator bool () const noexcept { return capacity_ != 0; }
+
+
+    void reserve(size_type capacity) noexcept {
+      capacity_ = capacity;
+    }
+
+
+    void publish(index_type n) {
+      publish(n, n);
+    }
+
+
+    void publish(index_type lo, index_type hi) {
+      publish(lo, hi, [this](auto&& ready) {
+        wait_strategy_.wait(ready);
+        return true;
+      });
+    }
+
+
+    // wait(ready) returns true once ready() holds, or false when it gives
+    // up. The range then stays unpublished.
+    template<typename F> bool publish(index_type lo, index_type hi, F&& wait) {
+      auto const ready = [&] { return cursor_.value() == lo - 1; };
+      if(!ready() && !wait(ready))
+        return false;
+      cursor_.lazy_store(hi);
+      wait_strategy_.notify();
+      return true;
+    }
+
+
+    bool published(index_type n) const noexcept {
+      return n <= cursor_.value();
+    }
+
+
+    index_type scan(index_type n) const noexcept {
+      auto const last = cursor_.value();
+      return n <= last ? last + 1 : n;
+    }
+
+
+    sequence const& cursor() const noexcept {
+      return cursor_;
+    }
+
+  private:
+
+    sequence cursor_;
+    size_type capacity_{0};
+    W wait_strategy_;
+
+  }; // ordered_cursor
+
+
+} // udisruptor
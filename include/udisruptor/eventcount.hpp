@@ -0,0 +1,158 @@
+/* This file is part of udisruptor library
+ * Copyright 2020 Andrei Ilin <ortfero@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include "sequence.hpp"
+
+#if defined(__linux__)
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+
+namespace udisruptor {
+
+
+  // Waiters register themselves before checking their condition, so
+  // notify_all() is a fence and a load unless somebody is actually parked:
+  //
+  //   auto const key = events.prepare_wait();
+  //   if(ready())
+  //     events.cancel_wait();
+  //   else
+  //     events.commit_wait(key);
+  class eventcount {
+  public:
+
+    using key_type = uint32_t;
+
+    eventcount() noexcept = default;
+    eventcount(eventcount const&) = delete;
+    eventcount& operator = (eventcount const&) = delete;
+
+
+    key_type prepare_wait() noexcept {
+      waiters_.fetch_add(1, std::memory_order_seq_cst);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      return epoch_.load(std::memory_order_acquire);
+    }
+
+
+    void cancel_wait() noexcept {
+      waiters_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+
+    void commit_wait(key_type key) noexcept {
+#if defined(__linux__)
+      while(epoch_.load(std::memory_order_acquire) == key)
+        futex(FUTEX_WAIT_PRIVATE, key, nullptr);
+#else
+      {
+        std::unique_lock<std::mutex> lock{mutex_};
+        while(epoch_.load(std::memory_order_acquire) == key)
+          condition_.wait(lock);
+      }
+#endif
+      waiters_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+
+    // Returns false when the deadline passed before notification
+    template<typename Clock, typename Duration>
+    bool commit_wait_until(key_type key,
+                           std::chrono::time_point<Clock, Duration> const& deadline) noexcept {
+      using namespace std::chrono;
+      bool notified = true;
+#if defined(__linux__)
+      while(epoch_.load(std::memory_order_acquire) == key) {
+        auto const now = Clock::now();
+        if(now >= deadline) {
+          notified = false;
+          break;
+        }
+        auto const left = duration_cast<nanoseconds>(deadline - now).count();
+        timespec timeout;
+        timeout.tv_sec = time_t(left / 1000000000);
+        timeout.tv_nsec = long(left % 1000000000);
+        futex(FUTEX_WAIT_PRIVATE, key, &timeout);
+      }
+#else
+      {
+        std::unique_lock<std::mutex> lock{mutex_};
+        notified = condition_.wait_until(lock, deadline, [&] {
+          return epoch_.load(std::memory_order_acquire) != key;
+        });
+      }
+#endif
+      waiters_.fetch_sub(1, std::memory_order_relaxed);
+      return notified;
+    }
+
+
+    void notify_all() noexcept {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if(waiters_.load(std::memory_order_relaxed) == 0)
+        return;
+      epoch_.fetch_add(1, std::memory_order_release);
+#if defined(__linux__)
+      futex(FUTEX_WAKE_PRIVATE, INT_MAX, nullptr);
+#else
+      { std::lock_guard<std::mutex> lock{mutex_}; }
+      condition_.notify_all();
+#endif
+    }
+
+
+  private:
+
+    alignas(sequence::cacheline) std::atomic<key_type> epoch_{0};
+    std::atomic<key_type> waiters_{0};
+#if !defined(__linux__)
+    std::mutex mutex_;
+    std::condition_variable condition_;
+#endif
+
+
+#if defined(__linux__)
+    long futex(int op, key_type value, timespec const* timeout) noexcept {
+      return syscall(SYS_futex, reinterpret_cast<key_type*>(&epoch_), op, value,
+                     timeout, nullptr, 0);
+    }
+#endif
+
+  }; // eventcount
+
+
+} // udisruptor
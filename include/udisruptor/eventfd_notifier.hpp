@@ -0,0 +1,87 @@
+/* This file is part of udisruptor library
+ * Copyright 2020 Andrei Ilin <ortfero@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <cerrno>
+#include <cstdint>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "notifier.hpp"
+
+
+namespace udisruptor {
+
+
+  // Makes an eventfd readable for epoll/poll when the consumer has
+  // something to fetch
+  class eventfd_notifier : public notifier {
+  public:
+
+    eventfd_notifier() noexcept:
+      fd_{::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)}
+    { }
+
+
+    ~eventfd_notifier() override {
+      if(fd_ != -1)
+        ::close(fd_);
+    }
+
+
+    explicit operator bool () const noexcept {
+      return fd_ != -1;
+    }
+
+
+    int fd() const noexcept {
+      return fd_;
+    }
+
+
+    // Clears readiness, call it before draining the ring
+    void reset() noexcept {
+      uint64_t value;
+      while(::read(fd_, &value, sizeof(value)) == -1 && errno == EINTR)
+        ;
+    }
+
+
+  protected:
+
+    void signal() noexcept override {
+      uint64_t const value = 1;
+      while(::write(fd_, &value, sizeof(value)) == -1 && errno == EINTR)
+        ;
+    }
+
+
+  private:
+
+    int fd_;
+
+  }; // eventfd_notifier
+
+
+} // udisruptor
@@ -0,0 +1,148 @@
+/* This file is part of udisruptor library
+ * Copyright 2020 Andrei Ilin <ortfero@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "sequence.hpp"
+
+
+namespace udisruptor {
+
+
+  // Tree of partial minimums over many consumers. Each commit() raises
+  // the consumer's groups of fan_out nodes up to root, and stops at the
+  // first level which does not advance. Producers or a barrier then gate
+  // on root alone, so their cost does not depend on the number of
+  // consumers:
+  //
+  //   gating_tree tree{*sequencer.add_consumer(), 128};
+  //   auto consumer_seq = tree.add_consumer();
+  //   ...
+  //   if(tree.commit(*consumer_seq, last))
+  //     sequencer.notify_consumed();
+  //
+  // Every leaf starts at -1, so root stays there until all consumers the
+  // tree was made for are added and commit. Producers stall after a lap
+  // while a leaf is never added.
+  class gating_tree {
+  public:
+
+    using index_type = sequence::value_type;
+    using size_type = sequence::value_type;
+
+    gating_tree(gating_tree const&) = delete;
+    gating_tree& operator = (gating_tree const&) = delete;
+
+
+    gating_tree(sequence& root, size_type consumers, size_type fan_out = 8):
+      root_{&root},
+      fan_out_{fan_out < 2 ? 2 : fan_out} {
+      auto nodes = consumers;
+      for(auto size = consumers; size > fan_out_; ) {
+        size = (size + fan_out_ - 1) / fan_out_;
+        nodes += size;
+      }
+      nodes_ = std::make_unique<sequence[]>(nodes);
+      for(auto size = consumers, offset = size_type(0); ; ) {
+        levels_.push_back({offset, size});
+        if(size <= fan_out_)
+          break;
+        offset += size;
+        size = (size + fan_out_ - 1) / fan_out_;
+      }
+    }
+
+
+    // Returns nullptr once every consumer the tree was made for is added.
+    // Consumer threads may add themselves concurrently.
+    sequence* add_consumer() noexcept {
+      auto added = added_.load(std::memory_order_relaxed);
+      while(added != levels_.front().size)
+        if(added_.compare_exchange_weak(added, added + 1, std::memory_order_relaxed))
+          return &nodes_[added];
+      return nullptr;
+    }
+
+
+    // Returns true if root advanced and gated producers should be woken
+    bool commit(sequence& consumer, index_type n) noexcept {
+      consumer.lazy_store(n);
+      auto index = size_type(&consumer - nodes_.get());
+      for(size_type level = 0; level != size_type(levels_.size()); ++level) {
+        // Either this consumer sees the sibling which advanced concurrently
+        // or the sibling sees this one, so no level keeps a stale minimum
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto const& current = levels_[level];
+        auto const first = index / fan_out_ * fan_out_;
+        auto const last = first + fan_out_ < current.size ? first + fan_out_ : current.size;
+        auto minimum = nodes_[current.offset + first].value();
+        for(auto i = first + 1; i < last; ++i) {
+          auto const m = nodes_[current.offset + i].value();
+          if(m < minimum)
+            minimum = m;
+        }
+        index /= fan_out_;
+        auto& parent = level + 1 == size_type(levels_.size())
+          ? *root_
+          : nodes_[levels_[level + 1].offset + index];
+        if(!raise(parent, minimum))
+          return false;
+      }
+      return true;
+    }
+
+
+    sequence const& root() const noexcept {
+      return *root_;
+    }
+
+  private:
+
+    struct level {
+      size_type offset;
+      size_type size;
+    };
+
+    sequence* root_;
+    size_type fan_out_;
+    std::unique_ptr<sequence[]> nodes_;
+    std::vector<level> levels_;
+    std::atomic<size_type> added_{0};
+
+
+    static bool raise(sequence& node, index_type n) noexcept {
+      auto current = node.value();
+      while(current < n)
+        if(node.compare_exchange(current, n))
+          return true;
+      return false;
+    }
+
+  }; // gating_tree
+
+
+} // udisruptor
@@ -0,0 +1,147 @@
+/* This file is part of udisruptor library
+ * Copyright 2020 Andrei Ilin <ortfero@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+#include "sequence.hpp"
+
+
+namespace udisruptor {
+
+
+  // Partition of member out of members which handles indices equal to
+  // member modulo members. Other slots are stepped over without a load.
+  struct stripe {
+
+    using index_type = sequence::value_type;
+    using size_type = sequence::value_type;
+
+    size_type members{1};
+    size_type member{0};
+
+    template<typename B, typename H>
+    size_type handle(B& buffer, index_type first, index_type last, H& handler) {
+      auto const lo = first + (member - first % members + members) % members;
+      if(lo > last)
+        return 0;
+      auto const hi = lo + (last - lo) / members * members;
+      for(auto i = lo; i != hi; i += members)
+        handler(buffer[i], i, false);
+      handler(buffer[hi], hi, true);
+      return (hi - lo) / members + 1;
+    }
+
+  }; // stripe
+
+
+  struct default_hash {
+    template<typename K> std::size_t operator () (K const& key) const {
+      return std::hash<K>{}(key);
+    }
+  }; // default_hash
+
+
+  // Partition of member out of members which handles events whose key
+  // hashes to member, so events of a key are handled in order by one
+  // member. K extracts the key of an event.
+  template<typename K, typename Hash = default_hash>
+  struct key_affinity {
+
+    using index_type = sequence::value_type;
+    using size_type = sequence::value_type;
+
+    K key;
+    Hash hash{};
+    size_type members{1};
+    size_type member{0};
+
+    template<typename B, typename H>
+    size_type handle(B& buffer, index_type first, index_type last, H& handler) {
+      auto const owns = [&](index_type i) {
+        return size_type(hash(key(buffer[i])) % std::size_t(members)) == member;
+      };
+      auto hi = last;
+      while(hi >= first && !owns(hi))
+        --hi;
+      if(hi < first)
+        return 0;
+      size_type handled = 1;
+      for(auto i = first; i != hi; ++i)
+        if(owns(i)) {
+          handler(buffer[i], i, false);
+          ++handled;
+        }
+      handler(buffer[hi], hi, true);
+      return handled;
+    }
+
+  }; // key_affinity
+
+
+  // Handlers of one stage sharing its events by partition P, one
+  // processor for each handler:
+  //
+  //   graph.handle_events_with(udisruptor::striped(validators));
+  //   graph.handle_events_with(udisruptor::by_key(validators, [](order const& o) {
+  //     return o.instrument;
+  //   }));
+  template<typename H, typename P>
+  struct handler_group {
+
+    using size_type = sequence::value_type;
+
+    std::vector<H>* handlers;
+    P partition;
+
+    size_type members() const noexcept {
+      return size_type(handlers->size());
+    }
+
+
+    P member(size_type i) const {
+      auto p = partition;
+      p.members = members();
+      p.member = i;
+      return p;
+    }
+
+  }; // handler_group
+
+
+  template<typename H> handler_group<H, stripe> striped(std::vector<H>& handlers) {
+    return {&handlers, stripe{}};
+  }
+
+
+  template<typename H, typename K, typename Hash = default_hash>
+  handler_group<H, key_affinity<K, Hash>> by_key(std::vector<H>& handlers, K key,
+                                                 Hash hash = Hash{}) {
+    return {&handlers, key_affinity<K, Hash>{std::move(key), std::move(hash)}};
+  }
+
+
+} // udisruptor
@@ -0,0 +1,261 @@
+/* This file is part of udisruptor library
+ * Copyright 2020 Andrei Ilin <ortfero@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "ring_buffer.hpp"
+#include "sequencer.hpp"
+
+
+namespace udisruptor {
+
+
+  // Multi-producer ring made of single-producer lanes, one per producer
+  // thread. Producers share no cache lines; consumers drain lanes in turn,
+  // so events keep their order within a lane but not across lanes.
+  template<typename T, typename W = yielding_wait>
+  class multilane_ring_buffer {
+  public:
+
+    using index_type = sequence::value_type;
+    using size_type = sequence::value_type;
+    using value_type = T;
+
+
+    class lane {
+    public:
+
+      index_type claim() noexcept {
+        return sequencer_.claim();
+      }
+
+
+      index_type claim(size_type n) noexcept {
+        return sequencer_.claim(n);
+      }
+
+
+      index_type try_claim() noexcept {
+        return sequencer_.try_claim();
+      }
+
+
+      index_type try_claim(size_type n) noexcept {
+        return sequencer_.try_claim(n);
+      }
+
+
+      void publish(index_type n) {
+        sequencer_.publish(n);
+        owner_->publish_wait_.notify();
+      }
+
+
+      void publish(index_type lo, index_type hi) {
+        sequencer_.publish(lo, hi);
+        owner_->publish_wait_.notify();
+      }
+
+
+      T& operator [] (index_type n) noexcept {
+        return buffer_[n];
+      }
+
+    private:
+
+      friend class multilane_ring_buffer;
+
+      ring_buffer<T> buffer_;
+      basic_sequencer<W> sequencer_;
+      multilane_ring_buffer* owner_{nullptr};
+
+    }; // lane
+
+
+    class consumer {
+    private:
+
+      friend class multilane_ring_buffer;
+
+      std::vector<sequence*> sequences_;
+      size_type next_lane_{0};
+
+    }; // consumer
+
+
+    multilane_ring_buffer(multilane_ring_buffer const&) = delete;
+    multilane_ring_buffer& operator = (multilane_ring_buffer const&) = delete;
+
+
+    // Capacity is per lane
+    multilane_ring_buffer(size_type lanes, size_type capacity,
+                          W const& wait_strategy = W{}):
+      lanes_count_{lanes},
+      lanes_{std::make_unique<lane[]>(lanes)},
+      publish_wait_{wait_strategy} {
+      for(auto& lane: *this) {
+        lane.buffer_.reserve(capacity);
+        lane.sequencer_ = basic_sequencer<W>{lane.buffer_.capacity(), wait_strategy};
+        lane.owner_ = this;
+      }
+    }
+
+
+    explicit operator bool () noexcept {
+      if(lanes_count_ == 0)
+        return false;
+      for(auto& lane: *this)
+        if(!lane.buffer_ || !lane.sequencer_)
+          return false;
+      return true;
+    }
+
+
+    size_type lanes() const noexcept {
+      return lanes_count_;
+    }
+
+
+    // Lane of a single producer thread
+    lane& producer(size_type n) noexcept {
+      return lanes_[n];
+    }
+
+
+    consumer add_consumer() {
+      consumer c;
+      for(auto& lane: *this)
+        c.sequences_.push_back(lane.sequencer_.add_consumer());
+      return c;
+    }
+
+
+    // Passes to handler up to batch events from each lane in turn and
+    // returns how many
+    template<typename F>
+    size_type try_drain(consumer& c, F&& handler,
+                        size_type batch = std::numeric_limits<size_type>::max()) {
+      size_type handled = 0;
+      for(size_type i = 0; i != lanes_count_; ++i) {
+        auto& lane = lanes_[c.next_lane_];
+        auto& consumer_seq = *c.sequences_[c.next_lane_];
+        if(++c.next_lane_ == lanes_count_)
+          c.next_lane_ = 0;
+        auto const next = consumer_seq.next();
+        auto until = lane.sequencer_.try_fetch_all(next);
+        if(until - next > batch)
+          until = next + batch;
+        if(until == next)
+          continue;
+        for(auto n = next; n != until; ++n)
+          handler(lane.buffer_[n]);
+        lane.sequencer_.commit(consumer_seq, until - 1);
+        handled += until - next;
+      }
+      return handled;
+    }
+
+
+    // Returns how many events were handled or sequence::alerted
+    template<typename F>
+    size_type drain(consumer& c, F&& handler,
+                    size_type batch = std::numeric_limits<size_type>::max()) {
+      for(;;) {
+        if(state_.load(std::memory_order_relaxed) == state_alerted)
+          return sequence::alerted;
+        auto const handled = try_drain(c, handler, batch);
+        if(handled != 0)
+          return handled;
+        if(state_.load(std::memory_order_acquire) != state_running
+           && !pending(c))
+          return sequence::alerted;
+        publish_wait_.wait([&] {
+          return pending(c) || state_.load(std::memory_order_relaxed) != state_running;
+        });
+      }
+    }
+
+
+    // Claims return sequence::alerted, drain() returns sequence::alerted
+    // once consumers handled everything published
+    void halt() {
+      stop(state_halted);
+    }
+
+
+    // Every wait returns sequence::alerted at once
+    void alert() {
+      stop(state_alerted);
+    }
+
+
+    void resume() noexcept {
+      state_.store(state_running, std::memory_order_release);
+      for(auto& lane: *this)
+        lane.sequencer_.resume();
+    }
+
+
+    lane* begin() noexcept { return lanes_.get(); }
+    lane* end() noexcept { return lanes_.get() + lanes_count_; }
+
+  private:
+
+    enum state : int {
+      state_running, state_halted, state_alerted
+    };
+
+    size_type lanes_count_{0};
+    std::unique_ptr<lane[]> lanes_;
+    W publish_wait_;
+    std::atomic<int> state_{state_running};
+
+
+    bool pending(consumer const& c) noexcept {
+      for(size_type i = 0; i != lanes_count_; ++i)
+        if(lanes_[i].sequencer_.try_fetch(c.sequences_[i]->next()) != sequence::invalid)
+          return true;
+      return false;
+    }
+
+
+    void stop(state s) {
+      state_.store(s, std::memory_order_seq_cst);
+      for(auto& lane: *this) {
+        if(s == state_alerted)
+          lane.sequencer_.alert();
+        else
+          lane.sequencer_.halt();
+      }
+      publish_wait_.notify();
+    }
+
+  }; // multilane_ring_buffer
+
+
+} // udisruptor
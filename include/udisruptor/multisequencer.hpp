@@ -25,70 +25,197 @@
 
 #include <memory>
 #include "base_sequencer.hpp"
+#include "availability.hpp"
 
 
 namespace udisruptor {
   
   
-  class multisequencer : public base_sequencer {
+  template<typename W, typename A = sequence_availability, std::size_t N = 0>
+  class basic_multisequencer : public base_sequencer<W, N> {
   public:
   
-    using base = base_sequencer;
+    using base = base_sequencer<W, N>;
+    using typename base::index_type;
+    using typename base::size_type;
+    using availability_type = A;
     
-    multisequencer() noexcept = default;
-    multisequencer(multisequencer const&) = delete;
-    multisequencer& operator = (multisequencer const&) = delete;
+    basic_multisequencer() noexcept = default;
+    basic_multisequencer(basic_multisequencer const&) = delete;
+    basic_multisequencer& operator = (basic_multisequencer const&) = delete;
     
-    multisequencer(multisequencer&& other) noexcept:
+    basic_multisequencer(basic_multisequencer&& other) noexcept:
       base(std::move(other)),
-      index_mask_{other.index_mask_},      
       producer_{other.producer_.load()},
+      cached_last_{other.cached_last_},
       published_{std::move(other.published_)}
     { }
 
 
-    multisequencer& operator = (multisequencer&& other) noexcept {
+    basic_multisequencer& operator = (basic_multisequencer&& other) noexcept {
       base::operator = (std::move(other));
-      index_mask_ = other.index_mask_;
       producer_.store(other.producer_.load());
+      cached_last_ = other.cached_last_;
       published_ = std::move(other.published_);
       return *this;
     }
     
     
-    explicit multisequencer(size_type capacity) {
+    explicit basic_multisequencer(size_type capacity, W const& wait_strategy = W{}):
+      base{wait_strategy} {
       reserve(capacity);
     }
 
 
     void reserve(size_type capacity) {
       base::reserve(capacity);
-      capacity = base::capacity();
-      published_ = std::make_unique<index_type[]>(capacity);
-      for(size_type n = 0; n != capacity; ++n)
-        published_[n] = 0;
-      index_mask_ = index_type(capacity - 1);
+      published_.reserve(base::capacity());
+    }
+
+
+    // Consumers added while producers run start after the last claimed
+    // index. Returns nullptr when all N consumers are added.
+    sequence* add_consumer() {
+      return base::add_consumer(consumer_cursor());
+    }
+
+
+    // Gates producers on a sequence owned elsewhere, set like the one of
+    // add_consumer(). Returns false when N is fixed.
+    bool add_consumer(sequence& consumer) {
+      return base::add_consumer(consumer, consumer_cursor());
     }
     
     
+    // Claims through the multisequencer share one gating cache, a
+    // producer() keeps its own
+    class producer {
+    public:
+
+      producer() noexcept = default;
+
+      explicit producer(basic_multisequencer& sequencer) noexcept:
+        sequencer_{&sequencer}
+      { }
+
+
+      index_type claim() noexcept {
+        return sequencer_->claim(1, cached_last_);
+      }
+
+
+      index_type claim(size_type n) noexcept {
+        return sequencer_->claim(n, cached_last_);
+      }
+
+
+      index_type try_claim() noexcept {
+        return sequencer_->try_claim(1, cached_last_);
+      }
+
+
+      index_type try_claim(size_type n) noexcept {
+        return sequencer_->try_claim(n, cached_last_);
+      }
+
+
+      template<typename Clock, typename Duration>
+      index_type claim_until(std::chrono::time_point<Clock, Duration> const& deadline) {
+        return sequencer_->claim_until(1, deadline, cached_last_);
+      }
+
+
+      template<typename Clock, typename Duration>
+      index_type claim_until(size_type n,
+                             std::chrono::time_point<Clock, Duration> const& deadline) {
+        return sequencer_->claim_until(n, deadline, cached_last_);
+      }
+
+
+      void publish(index_type n) noexcept {
+        sequencer_->publish(n);
+      }
+
+
+      void publish(index_type lo, index_type hi) noexcept {
+        sequencer_->publish(lo, hi);
+      }
+
+    private:
+
+      basic_multisequencer* sequencer_{nullptr};
+      index_type cached_last_{sequence::invalid};
+
+    }; // producer
+
+
+    // Handle for a single producer thread, valid while the multisequencer
+    // is not moved
+    producer make_producer() noexcept {
+      return producer{*this};
+    }
+
+
+    // Claims after gating, so a claim interrupted by alert() or halt()
+    // returns sequence::alerted and leaves no unpublished slot behind
     index_type claim() noexcept {
-      if(!published_)
-        return sequence::invalid;
-      index_type const p = producer_.fetch_add(1);      
-      base::wait(p);
-      return p;
+      return claim(1, cached_last_);
+    }
+
+
+    index_type claim(size_type n) noexcept {
+      return claim(n, cached_last_);
+    }
+    
+    
+    index_type try_claim() noexcept {
+      return try_claim(1, cached_last_);
+    }
+
+
+    index_type try_claim(size_type n) noexcept {
+      return try_claim(n, cached_last_);
+    }
+
+
+    template<typename Clock, typename Duration>
+    index_type claim_until(std::chrono::time_point<Clock, Duration> const& deadline) {
+      return claim_until(1, deadline, cached_last_);
+    }
+
+
+    template<typename Clock, typename Duration>
+    index_type claim_until(size_type n,
+                           std::chrono::time_point<Clock, Duration> const& deadline) {
+      return claim_until(n, deadline, cached_last_);
     }
     
     
     void publish(index_type n) noexcept {
-      published_[n & index_mask_] = n + 1;
+      if constexpr(detail::waits_to_publish<A>::value)
+        return publish(n, n);
+      published_.publish(n);
+      base::notify_published();
+    }
+
+
+    // Policies which publish in claim order wait for earlier claims until
+    // alert(), which leaves the range unpublished
+    void publish(index_type lo, index_type hi) noexcept {
+      if constexpr(detail::waits_to_publish<A>::value)
+        published_.publish(lo, hi, [this](auto&& ready) {
+          return base::wait_unless_alerted(ready);
+        });
+      else
+        published_.publish(lo, hi);
+      base::notify_published();
     }
 
 
     index_type try_fetch(index_type consumer) noexcept {
       if(!published_)
         return sequence::invalid;
-      if(published_[consumer & index_mask_] != consumer + 1)
+      if(!published_.published(consumer))
         return sequence::invalid;
       return consumer;
     }
@@ -97,20 +224,117 @@ namespace udisruptor {
     index_type try_fetch_all(index_type consumer) noexcept {
       if(!published_)
         return consumer;
-      while(published_[consumer & index_mask_] == consumer + 1)
-        ++consumer;
-      return consumer;
+      return published_.scan(consumer);
+    }
+
+
+    // Returns the last available sequence or sequence::alerted
+    index_type wait_for(index_type consumer) {
+      if(!published_)
+        return sequence::invalid;
+      if(!published_.published(consumer)) {
+        base::wait_published([&] { return published_.published(consumer); });
+        if(!published_.published(consumer))
+          return sequence::alerted;
+      }
+      if(base::alerted())
+        return sequence::alerted;
+      return try_fetch_all(consumer + 1) - 1;
+    }
+
+
+    A& availability() noexcept {
+      return published_;
+    }
+
+
+    A const& availability() const noexcept {
+      return published_;
+    }
+
+
+    // Highest contiguously published index, for cursor policies only
+    sequence const& cursor() const noexcept {
+      return published_.cursor();
+    }
+
+
+    // Arms n to be signalled when consumer gets published. Returns false
+    // and leaves n disarmed if there is something to fetch already.
+    bool arm(notifier& n, index_type consumer) noexcept {
+      n.arm();
+      if(try_fetch(consumer) == sequence::invalid)
+        return true;
+      n.disarm();
+      return false;
     }
 
     
   private:
+
+    template<typename> friend class claim_combiner;
   
-    size_type capacity_{0};
-    index_type index_mask_{0};
     alignas(sequence::cacheline) std::atomic<index_type> producer_{0};
-    std::unique_ptr<index_type[]> published_;
+    sequence cached_last_;
+    A published_;
+
+
+    // Where consumers join, and where producers gate while there are none
+    auto consumer_cursor() const noexcept {
+      return [this] { return producer_.load() - 1; };
+    }
+
+
+    template<typename C> index_type claim(size_type n, C& cached_last) noexcept {
+      if(!published_ || n < 1 || n > base::capacity())
+        return sequence::invalid;
+      auto p = producer_.load();
+      do {
+        if(base::halted())
+          return sequence::alerted;
+        if(base::wait(p + n - 1, cached_last, consumer_cursor()) == sequence::alerted)
+          return sequence::alerted;
+      } while(!producer_.compare_exchange_weak(p, p + n));
+      return p;
+    }
+
+
+    template<typename C> index_type try_claim(size_type n, C& cached_last) noexcept {
+      if(!published_ || n < 1 || n > base::capacity())
+        return sequence::invalid;
+      auto p = producer_.load();
+      do {
+        if(base::halted())
+          return sequence::alerted;
+        if(!base::available(p + n - 1, cached_last, consumer_cursor()))
+          return sequence::invalid;
+      } while(!producer_.compare_exchange_weak(p, p + n));
+      return p;
+    }
+
+
+    template<typename C, typename Clock, typename Duration>
+    index_type claim_until(size_type n,
+                           std::chrono::time_point<Clock, Duration> const& deadline,
+                           C& cached_last) {
+      if(!published_ || n < 1 || n > base::capacity())
+        return sequence::invalid;
+      auto p = producer_.load();
+      do {
+        if(base::halted())
+          return sequence::alerted;
+        auto const last = base::wait_until(p + n - 1, deadline, cached_last,
+                                           consumer_cursor());
+        if(last < 0)
+          return last;
+      } while(!producer_.compare_exchange_weak(p, p + n));
+      return p;
+    }
     
-  }; // multisequencer
+  }; // basic_multisequencer
+
+
+  using multisequencer = basic_multisequencer<yielding_wait>;
   
   
 } // udisruptor
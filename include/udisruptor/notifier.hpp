@@ -0,0 +1,85 @@
+/* This file is part of udisruptor library
+ * Copyright 2020 Andrei Ilin <ortfero@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <atomic>
+
+
+namespace udisruptor {
+
+
+  // Edge-triggered readiness signal for consumers which can't block inside
+  // the disruptor. A consumer arms it through its sequencer when it found
+  // nothing to fetch; the next publish() disarms it and calls signal() once,
+  // however many events are published afterwards.
+  class notifier {
+  public:
+
+    notifier() noexcept = default;
+    notifier(notifier const&) = delete;
+    notifier& operator = (notifier const&) = delete;
+    virtual ~notifier() = default;
+
+
+    // Pairs with the fence of a publisher before it checks armed(): either
+    // the consumer's next fetch sees the publish or the publisher sees it
+    // armed
+    void arm() noexcept {
+      armed_.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+
+    void disarm() noexcept {
+      armed_.store(false, std::memory_order_relaxed);
+    }
+
+
+    bool armed() const noexcept {
+      return armed_.load(std::memory_order_relaxed);
+    }
+
+
+    void notify() noexcept {
+      if(!armed_.load(std::memory_order_relaxed))
+        return;
+      if(armed_.exchange(false, std::memory_order_acq_rel))
+        signal();
+    }
+
+
+  protected:
+
+    virtual void signal() noexcept = 0;
+
+
+  private:
+
+    std::atomic<bool> armed_{false};
+
+  }; // notifier
+
+
+} // udisruptor
@@ -23,14 +23,18 @@
 #pragma once
 
 
+#include <cstddef>
 #include <memory>
 #include "sequence.hpp"
+#include "slot_index.hpp"
 
 
 namespace udisruptor {
 
 
-  template<typename T>
+  // I maps sequences to slots, see slot_index.hpp. Align pads each slot,
+  // sequence::cacheline keeps small events of different producers apart.
+  template<typename T, typename I = linear_index, std::size_t Align = alignof(T)>
   class ring_buffer {
   public:
 
@@ -56,25 +60,29 @@ namespace udisruptor {
     void reserve(size_type capacity) {
       capacity = nearest_power_of_2(capacity);
       capacity_ = capacity;
-      index_mask_ = index_type(capacity - 1);
-      pool_ = std::make_unique<T[]>(capacity);
+      index_.reserve(capacity);
+      pool_ = std::make_unique<slot[]>(capacity);
     }
 
 
     T& operator [] (index_type n) noexcept {
-      return pool_[n & index_mask_];
+      return pool_[index_(n)].value;
     }
 
 
     T const& operator [] (index_type n) const noexcept {
-      return pool_[n & index_mask_];
+      return pool_[index_(n)].value;
     }
 
   private:
 
+    struct slot {
+      alignas(Align) T value;
+    };
+
     size_type capacity_{0};
-    index_type index_mask_{0};
-    std::unique_ptr<T[]> pool_;
+    I index_;
+    std::unique_ptr<slot[]> pool_;
  
 
     static uint64_t nearest_power_of_2(uint64_t n) {
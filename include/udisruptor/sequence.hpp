@@ -25,46 +25,98 @@
 
 #include <cstdint>
 #include <atomic>
+#include <cstddef>
+
+
+#if !defined(UDISRUPTOR_CACHELINE)
+#define UDISRUPTOR_CACHELINE 64
+#endif
 
 
 namespace udisruptor {
 
 
+  // Loads acquire and stores release, which are plain MOVs on x86.
+  // Use value_relaxed() where ordering is provided otherwise, and store()
+  // where a later load must not be reordered before the store.
   class sequence {
   public:
   
-    static constexpr std::size_t cacheline = 64;
+    // Alignment of state written by different threads. 128 also keeps
+    // the adjacent line prefetcher of Intel cores from pairing lines.
+    static constexpr std::size_t cacheline = UDISRUPTOR_CACHELINE;
 
     using value_type = int64_t;
     
     static constexpr value_type invalid = -1;
+    static constexpr value_type alerted = -2;
 
     constexpr sequence() noexcept: value_{invalid} { }
     explicit constexpr sequence(value_type n) noexcept: value_{n} { }
-    value_type value() const noexcept { return value_; }
-    value_type next() const noexcept { return value_ + 1; }    
+
+
+    value_type value() const noexcept {
+      return value_.load(std::memory_order_acquire);
+    }
+
+
+    value_type value_relaxed() const noexcept {
+      return value_.load(std::memory_order_relaxed);
+    }
+
+
+    value_type next() const noexcept {
+      return value() + 1;
+    }
+
+
+    void lazy_store(value_type n) noexcept {
+      value_.store(n, std::memory_order_release);
+    }
+
+
+    void store(value_type n) noexcept {
+      value_.store(n, std::memory_order_seq_cst);
+    }
+
+    
+    // Stores desired if the sequence still equals expected, otherwise
+    // loads the current value into expected
+    bool compare_exchange(value_type& expected, value_type desired) noexcept {
+      return value_.compare_exchange_strong(expected, desired,
+                                            std::memory_order_acq_rel,
+                                            std::memory_order_acquire);
+    }
+
     
     sequence& operator = (value_type n) noexcept {
-      value_ = n;
+      lazy_store(n);
       return *this;
     }
 
 
     sequence(sequence const& other) noexcept:
-      value_{other.value_}
+      value_{other.value()}
     { }
     
     sequence& operator = (sequence const& other) noexcept {
-      value_ = other.value_;
+      lazy_store(other.value());
       return *this;
     }
 
 
   private:
 
-    alignas(cacheline) value_type value_;
+    alignas(cacheline) std::atomic<value_type> value_;
 
   }; // sequence
 
 
+  static_assert((sequence::cacheline & (sequence::cacheline - 1)) == 0,
+                "UDISRUPTOR_CACHELINE should be a power of 2");
+  static_assert(sizeof(sequence) == sequence::cacheline
+                && alignof(sequence) == sequence::cacheline,
+                "sequence should take a whole cache line");
+
+
 } // udisruptor
@@ -0,0 +1,368 @@
+/* This file is part of udisruptor library
+ * Copyright 2020 Andrei Ilin <ortfero@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "sequence.hpp"
+
+
+namespace udisruptor {
+
+
+  // Consumers of a sequencer, N known at compile time or 0 for any number.
+  // Fixed sets keep sequences inline and unroll minimum().
+  template<std::size_t N>
+  class consumer_set {
+  public:
+
+    using index_type = sequence::value_type;
+
+    // Returns nullptr when all N are added. Fixed sets are filled before
+    // producers start.
+    template<typename F> sequence* add(F&& cursor) noexcept {
+      if(size_ == N)
+        return nullptr;
+      auto& s = sequences_[size_++];
+      s.lazy_store(cursor());
+      return &s;
+    }
+
+
+    // Fixed sets keep their sequences inline and for good
+    template<typename F> bool add(sequence&, F&&) noexcept {
+      return false;
+    }
+
+
+    bool remove(sequence const*) noexcept {
+      return false;
+    }
+
+
+    // Every one of N consumers gates producers, so all have to be added
+    bool ready() const noexcept {
+      return size_ == N;
+    }
+
+
+    template<typename F> index_type minimum(F&&) const noexcept {
+      return minimum(std::make_index_sequence<N>{});
+    }
+
+  private:
+
+    std::array<sequence, N> sequences_;
+    std::size_t size_{0};
+
+
+    template<std::size_t... I>
+    index_type minimum(std::index_sequence<I...>) const noexcept {
+      auto last_value = std::numeric_limits<index_type>::max();
+      auto const take = [&](index_type m) {
+        if(m < last_value)
+          last_value = m;
+      };
+      (take(sequences_[I].value()), ...);
+      return last_value;
+    }
+
+  }; // consumer_set
+
+
+  // Consumers may be added and removed while producers run. Sequences live
+  // in chunks which are never moved or freed before the set, so pointers
+  // stay valid and producers scan without locks. Scans register with an
+  // epoch, and remove() waits for the ones which may still read the
+  // removed sequence.
+  template<>
+  class consumer_set<0> {
+  public:
+
+    using index_type = sequence::value_type;
+
+    consumer_set() noexcept = default;
+    consumer_set(consumer_set const&) = delete;
+    consumer_set& operator = (consumer_set const&) = delete;
+
+
+    consumer_set(consumer_set&& other) noexcept:
+      head_{other.head_.exchange(nullptr)},
+      active_{other.active_.load()}
+    { }
+
+
+    consumer_set& operator = (consumer_set&& other) noexcept {
+      delete head_.exchange(other.head_.exchange(nullptr));
+      active_.store(other.active_.load());
+      return *this;
+    }
+
+
+    ~consumer_set() {
+      delete head_.load();
+    }
+
+
+    template<typename F> sequence* add(F&& cursor) {
+      auto const [c, i] = acquire_slot();
+      activate(*c, i, c->sequences[i], std::forward<F>(cursor));
+      return &c->sequences[i];
+    }
+
+
+    // Gates on a sequence owned elsewhere, which may be freed once removed
+    template<typename F> bool add(sequence& consumer, F&& cursor) {
+      auto const [c, i] = acquire_slot();
+      activate(*c, i, consumer, std::forward<F>(cursor));
+      return true;
+    }
+
+
+    // Producers gate on the cursor while no consumer is active. Returns
+    // once no scan reads the sequence any more.
+    bool remove(sequence const* consumer) {
+      for(auto c = head_.load(); c != nullptr; c = c->next.load())
+        for(std::size_t i = 0; i != chunk_size; ++i) {
+          if(c->gates[i].load(std::memory_order_relaxed) != consumer)
+            continue;
+          auto expected = int(slot_active);
+          if(!c->states[i].compare_exchange_strong(expected, slot_taken))
+            continue;
+          active_.fetch_sub(1);
+          quiesce();
+          c->states[i].store(slot_free);
+          return true;
+        }
+      return false;
+    }
+
+
+    bool ready() const noexcept {
+      return active_.load(std::memory_order_relaxed) != 0;
+    }
+
+
+    // Pairs with the fence in add(): either a producer sees the new
+    // consumer or the consumer sees the producer's cursor. The cursor is
+    // read before the fence, so a consumer missed by the scan joins at or
+    // after it.
+    template<typename F> index_type minimum(F&& cursor) const noexcept {
+      auto const first = cursor();
+      auto const epoch = enter();
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      auto last_value = std::numeric_limits<index_type>::max();
+      for(auto c = head_.load(); c != nullptr; c = c->next.load())
+        for(std::size_t i = 0; i != chunk_size; ++i) {
+          if(c->states[i].load() != slot_active)
+            continue;
+          auto const m = c->gates[i].load(std::memory_order_relaxed)->value();
+          if(m < last_value)
+            last_value = m;
+        }
+      scans_[epoch & 1].fetch_sub(1, std::memory_order_release);
+      if(last_value == std::numeric_limits<index_type>::max())
+        return first;
+      return last_value;
+    }
+
+  private:
+
+    enum : int { slot_free, slot_taken, slot_active };
+
+    static constexpr std::size_t chunk_size = 16;
+
+    struct chunk {
+      sequence sequences[chunk_size];
+      alignas(sequence::cacheline) std::atomic<int> states[chunk_size] = { };
+      std::atomic<sequence*> gates[chunk_size] = { };
+      std::atomic<chunk*> next{nullptr};
+
+      ~chunk() { delete next.load(); }
+    }; // chunk
+
+    std::atomic<chunk*> head_{nullptr};
+    std::atomic<std::size_t> active_{0};
+
+    // Written by every scan, flipped by removals one at a time
+    alignas(sequence::cacheline) mutable std::atomic<std::size_t> epoch_{0};
+    mutable std::atomic<std::size_t> scans_[2] = { };
+    std::mutex removing_;
+
+
+    // The sequence is set to cursor() read after it became visible to
+    // producers, so it never lags behind what they may overwrite
+    template<typename F>
+    void activate(chunk& c, std::size_t i, sequence& consumer, F&& cursor) {
+      consumer.lazy_store(cursor());
+      c.gates[i].store(&consumer, std::memory_order_relaxed);
+      c.states[i].store(slot_active);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      auto const last = cursor();
+      if(last > consumer.value_relaxed())
+        consumer.lazy_store(last);
+      active_.fetch_add(1);
+    }
+
+
+    // Counts a scan in the current epoch, which removals wait to drain
+    std::size_t enter() const noexcept {
+      for(;;) {
+        auto const epoch = epoch_.load();
+        scans_[epoch & 1].fetch_add(1);
+        if(epoch_.load() == epoch)
+          return epoch;
+        scans_[epoch & 1].fetch_sub(1);
+      }
+    }
+
+
+    // Scans counted after the flip see the slot removed already, so only
+    // the ones of the epoch before have to finish
+    void quiesce() {
+      std::lock_guard lock{removing_};
+      auto const epoch = epoch_.fetch_add(1);
+      while(scans_[epoch & 1].load() != 0)
+        std::this_thread::yield();
+    }
+
+
+    std::pair<chunk*, std::size_t> acquire_slot() {
+      auto link = &head_;
+      for(;;) {
+        auto c = link->load();
+        if(c == nullptr) {
+          auto fresh = std::make_unique<chunk>();
+          if(link->compare_exchange_strong(c, fresh.get()))
+            c = fresh.release();
+        }
+        for(std::size_t i = 0; i != chunk_size; ++i) {
+          auto expected = int(slot_free);
+          if(c->states[i].load(std::memory_order_relaxed) == slot_free
+             && c->states[i].compare_exchange_strong(expected, slot_taken))
+            return {c, i};
+        }
+        link = &c->next;
+      }
+    }
+
+  }; // consumer_set<0>
+
+
+  // Dependencies of a barrier, N known at compile time or 0 for any number.
+  // Missing ones of a fixed set never hold the barrier back.
+  template<std::size_t N>
+  class dependency_set {
+  public:
+
+    using index_type = sequence::value_type;
+
+    dependency_set() noexcept {
+      sequences_.fill(&unbounded);
+    }
+
+
+    // Returns false when all N are added
+    bool add(sequence const& n) noexcept {
+      if(size_ == N)
+        return false;
+      sequences_[size_++] = &n;
+      return true;
+    }
+
+
+    bool empty() const noexcept {
+      return size_ == 0;
+    }
+
+
+    index_type minimum() const noexcept {
+      return minimum(std::make_index_sequence<N>{});
+    }
+
+  private:
+
+    static inline sequence const unbounded{std::numeric_limits<index_type>::max()};
+
+    std::array<sequence const*, N> sequences_;
+    std::size_t size_{0};
+
+
+    template<std::size_t... I>
+    index_type minimum(std::index_sequence<I...>) const noexcept {
+      auto last_value = std::numeric_limits<index_type>::max();
+      auto const take = [&](index_type m) {
+        if(m < last_value)
+          last_value = m;
+      };
+      (take(sequences_[I]->value()), ...);
+      return last_value;
+    }
+
+  }; // dependency_set
+
+
+  template<>
+  class dependency_set<0> {
+  public:
+
+    using index_type = sequence::value_type;
+
+    bool add(sequence const& n) {
+      sequences_.push_back(&n);
+      return true;
+    }
+
+
+    bool empty() const noexcept {
+      return sequences_.empty();
+    }
+
+
+    index_type minimum() const noexcept {
+      auto last_value = std::numeric_limits<index_type>::max();
+      for(auto dependency: sequences_) {
+        auto const m = dependency->value();
+        if(m < last_value)
+          last_value = m;
+      }
+      return last_value;
+    }
+
+  private:
+
+    std::vector<sequence const*> sequences_;
+
+  }; // dependency_set<0>
+
+
+} // udisruptor
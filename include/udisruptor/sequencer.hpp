@@ -29,54 +29,189 @@
 namespace udisruptor {
   
   
-  class sequencer : public base_sequencer {
+  template<typename W, std::size_t N = 0>
+  class basic_sequencer : public base_sequencer<W, N> {
   public:
   
-    using base = base_sequencer;
+    using base = base_sequencer<W, N>;
+    using typename base::index_type;
+    using typename base::size_type;
     
-    sequencer() noexcept = default;
-    sequencer(sequencer const&) = delete;
-    sequencer& operator = (sequencer const&) = delete;
-    sequencer(sequencer&& other) noexcept = default;
-    sequencer& operator = (sequencer&& other) noexcept = default;
+    basic_sequencer() noexcept = default;
+    basic_sequencer(basic_sequencer const&) = delete;
+    basic_sequencer& operator = (basic_sequencer const&) = delete;
+    basic_sequencer(basic_sequencer&& other) noexcept = default;
+    basic_sequencer& operator = (basic_sequencer&& other) noexcept = default;
         
-    explicit sequencer(size_type capacity) {
+    explicit basic_sequencer(size_type capacity, W const& wait_strategy = W{}):
+      base{wait_strategy} {
       base::reserve(capacity);
     }
+
+
+    // Consumers added while producers run start after the last published
+    // index. Returns nullptr when all N consumers are added.
+    sequence* add_consumer() {
+      return base::add_consumer(consumer_cursor());
+    }
+
+
+    // Gates producers on a sequence owned elsewhere, set like the one of
+    // add_consumer(). Returns false when N is fixed.
+    bool add_consumer(sequence& consumer) {
+      return base::add_consumer(consumer, consumer_cursor());
+    }
+
     
     index_type claim() noexcept {      
-      index_type const p = producer_++;
-      base::wait(p);
+      if(base::halted())
+        return sequence::alerted;
+      index_type const p = producer_.next;
+      if(base::wait(p, producer_.cached_last, consumer_cursor()) == sequence::alerted)
+        return sequence::alerted;
+      producer_.next = p + 1;
+      return p;
+    }
+
+
+    index_type claim(size_type n) noexcept {
+      if(n < 1 || n > base::capacity())
+        return sequence::invalid;
+      if(base::halted())
+        return sequence::alerted;
+      index_type const p = producer_.next;
+      if(base::wait(p + n - 1, producer_.cached_last, consumer_cursor()) == sequence::alerted)
+        return sequence::alerted;
+      producer_.next = p + n;
+      return p;
+    }
+    
+    
+    index_type try_claim() noexcept {
+      return try_claim(1);
+    }
+
+
+    index_type try_claim(size_type n) noexcept {
+      if(n < 1 || n > base::capacity())
+        return sequence::invalid;
+      if(base::halted())
+        return sequence::alerted;
+      index_type const p = producer_.next;
+      if(!base::available(p + n - 1, producer_.cached_last, consumer_cursor()))
+        return sequence::invalid;
+      producer_.next += n;
+      return p;
+    }
+
+
+    template<typename Clock, typename Duration>
+    index_type claim_until(std::chrono::time_point<Clock, Duration> const& deadline) {
+      return claim_until(1, deadline);
+    }
+
+
+    template<typename Clock, typename Duration>
+    index_type claim_until(size_type n,
+                           std::chrono::time_point<Clock, Duration> const& deadline) {
+      if(n < 1 || n > base::capacity())
+        return sequence::invalid;
+      if(base::halted())
+        return sequence::alerted;
+      index_type const p = producer_.next;
+      auto const last = base::wait_until(p + n - 1, deadline, producer_.cached_last,
+                                         consumer_cursor());
+      if(last < 0)
+        return last;
+      producer_.next += n;
       return p;
     }
     
     
     void publish(index_type n) noexcept {
-      publisher_ = n;
+      publisher_.lazy_store(n);
+      base::notify_published();
+    }
+
+
+    void publish(index_type, index_type hi) noexcept {
+      publisher_.lazy_store(hi);
+      base::notify_published();
     }
 
 
     index_type try_fetch(index_type consumer) noexcept {
-      if(publisher_ < consumer)
+      if(publisher_.value() < consumer)
         return sequence::invalid;
       return consumer;
     }
 
 
     index_type try_fetch_all(index_type consumer) noexcept {
-      if(publisher_ < consumer)
+      auto const last = publisher_.value();
+      if(last < consumer)
         return consumer;
-      return publisher_ + 1;
+      return last + 1;
+    }
+
+
+    // Returns the last available sequence or sequence::alerted
+    index_type wait_for(index_type consumer) {
+      auto last = publisher_.value();
+      if(last < consumer) {
+        base::wait_published([&] {
+          last = publisher_.value();
+          return last >= consumer;
+        });
+        if(last < consumer)
+          return sequence::alerted;
+      }
+      if(base::alerted())
+        return sequence::alerted;
+      return last;
     }
 
 
+    // Highest published index
+    sequence const& cursor() const noexcept {
+      return publisher_;
+    }
+
+
+    // Arms n to be signalled when consumer gets published. Returns false
+    // and leaves n disarmed if there is something to fetch already.
+    bool arm(notifier& n, index_type consumer) noexcept {
+      n.arm();
+      if(try_fetch(consumer) == sequence::invalid)
+        return true;
+      n.disarm();
+      return false;
+    }
+
     
   private:
   
-    index_type producer_{0};
-    index_type publisher_{-1};
+    // Producer-private state, consumers read publisher_ only
+    struct alignas(sequence::cacheline) producer_state {
+      index_type next{0};
+      index_type cached_last{sequence::invalid};
+    };
+
+    static_assert(sizeof(producer_state) == sequence::cacheline);
+
+    producer_state producer_;
+    sequence publisher_;
+
+
+    // Where consumers join, and where producers gate while there are none
+    auto consumer_cursor() const noexcept {
+      return [this] { return publisher_.value(); };
+    }
     
-  }; // sequencer
+  }; // basic_sequencer
+
+
+  using sequencer = basic_sequencer<yielding_wait>;
   
   
 } // udisruptor
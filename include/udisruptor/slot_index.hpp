@@ -0,0 +1,97 @@
+/* This file is part of udisruptor library
+ * Copyright 2020 Andrei Ilin <ortfero@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <cstddef>
+#include "sequence.hpp"
+
+
+namespace udisruptor {
+
+
+  // Slot mappings of power of 2 rings
+
+
+  class linear_index {
+  public:
+
+    using index_type = sequence::value_type;
+    using size_type = sequence::value_type;
+
+
+    void reserve(size_type capacity) noexcept {
+      index_mask_ = index_type(capacity - 1);
+    }
+
+
+    index_type operator () (index_type n) const noexcept {
+      return n & index_mask_;
+    }
+
+  private:
+
+    index_type index_mask_{0};
+
+  }; // linear_index
+
+
+  // Rotates slot numbers so their low bits select the cache line of an
+  // element of size E: consecutive sequences land on different lines and
+  // every slot is still visited once per lap
+  template<std::size_t E>
+  class scrambled_index {
+  public:
+
+    using index_type = sequence::value_type;
+    using size_type = sequence::value_type;
+
+
+    void reserve(size_type capacity) noexcept {
+      index_mask_ = index_type(capacity - 1);
+      int bits = 0;
+      while((size_type(1) << bits) != capacity)
+        ++bits;
+      line_bits_ = 0;
+      while(line_bits_ < bits && (E << (line_bits_ + 1)) <= sequence::cacheline)
+        ++line_bits_;
+      lines_shift_ = bits - line_bits_;
+    }
+
+
+    index_type operator () (index_type n) const noexcept {
+      auto const i = n & index_mask_;
+      return ((i << line_bits_) & index_mask_) | (i >> lines_shift_);
+    }
+
+  private:
+
+    index_type index_mask_{0};
+    int line_bits_{0};
+    int lines_shift_{0};
+
+  }; // scrambled_index
+
+
+} // udisruptor
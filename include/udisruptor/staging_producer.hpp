@@ -0,0 +1,119 @@
+/* This file is part of udisruptor library
+ * Copyright 2020 Andrei Ilin <ortfero@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <chrono>
+#include <memory>
+#include <utility>
+#include "ring_buffer.hpp"
+#include "sequence.hpp"
+
+
+namespace udisruptor {
+
+
+  // Producer which stages events of one thread and writes them to the ring
+  // with a single claim(n)/publish(lo, hi). P is the sequencer or a producer
+  // handle. Staged events are flushed when batch of them are collected or,
+  // from poll(), when the oldest one waited for max_delay.
+  template<typename T, typename P>
+  class staging_producer {
+  public:
+
+    using index_type = sequence::value_type;
+    using size_type = sequence::value_type;
+    using clock_type = std::chrono::steady_clock;
+
+    staging_producer() noexcept = default;
+    staging_producer(staging_producer&&) noexcept = default;
+    staging_producer& operator = (staging_producer&&) noexcept = default;
+
+
+    // batch should not exceed the capacity of the ring
+    staging_producer(ring_buffer<T>& buffer, P& producer, size_type batch,
+                     clock_type::duration max_delay = clock_type::duration::max()):
+      buffer_{&buffer},
+      producer_{&producer},
+      staged_{std::make_unique<T[]>(batch)},
+      batch_{batch},
+      max_delay_{max_delay}
+    { }
+
+
+    // Returns false without staging event when the batch is full and
+    // claim() was alerted
+    template<typename E> bool push(E&& event) {
+      if(size_ == batch_ && !flush())
+        return false;
+      if(size_ == 0 && max_delay_ != clock_type::duration::max())
+        oldest_ = clock_type::now();
+      staged_[size_++] = std::forward<E>(event);
+      if(size_ == batch_)
+        flush();
+      return true;
+    }
+
+
+    // Flushes if the oldest staged event waited for max_delay
+    bool poll() {
+      if(size_ == 0 || clock_type::now() - oldest_ < max_delay_)
+        return true;
+      return flush();
+    }
+
+
+    // Staged events are kept when claim() was alerted
+    bool flush() {
+      if(size_ == 0)
+        return true;
+      auto const first = producer_->claim(size_);
+      if(first < 0)
+        return false;
+      for(size_type i = 0; i != size_; ++i)
+        (*buffer_)[first + i] = std::move(staged_[i]);
+      producer_->publish(first, first + size_ - 1);
+      size_ = 0;
+      return true;
+    }
+
+
+    size_type size() const noexcept {
+      return size_;
+    }
+
+  private:
+
+    ring_buffer<T>* buffer_{nullptr};
+    P* producer_{nullptr};
+    std::unique_ptr<T[]> staged_;
+    size_type batch_{0};
+    size_type size_{0};
+    clock_type::duration max_delay_{clock_type::duration::max()};
+    clock_type::time_point oldest_;
+
+  }; // staging_producer
+
+
+} // udisruptor
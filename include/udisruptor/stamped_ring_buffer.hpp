@@ -0,0 +1,138 @@
+/* This file is part of udisruptor library
+ * Copyright 2020 Andrei Ilin <ortfero@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <atomic>
+#include <memory>
+#include "multisequencer.hpp"
+
+
+namespace udisruptor {
+
+
+  // Availability policy which keeps the n + 1 stamp of each slot next
+  // to its value, so consumers get both with the same cache line
+  template<typename T>
+  class stamped_availability {
+  public:
+
+    using index_type = sequence::value_type;
+    using size_type = sequence::value_type;
+
+    stamped_availability() noexcept = default;
+    stamped_availability(stamped_availability&&) noexcept = default;
+    stamped_availability& operator = (stamped_availability&&) noexcept = default;
+    explicit operator bool () const noexcept { return !!slots_; }
+
+
+    void reserve(size_type capacity) {
+      slots_ = std::make_unique<slot[]>(capacity);
+      for(size_type n = 0; n != capacity; ++n)
+        slots_[n].stamp.store(0, std::memory_order_relaxed);
+      index_mask_ = index_type(capacity - 1);
+    }
+
+
+    void publish(index_type n) noexcept {
+      slots_[n & index_mask_].stamp.store(n + 1, std::memory_order_release);
+    }
+
+
+    void publish(index_type lo, index_type hi) noexcept {
+      for(index_type n = hi; n >= lo; --n)
+        publish(n);
+    }
+
+
+    bool published(index_type n) const noexcept {
+      return slots_[n & index_mask_].stamp.load(std::memory_order_acquire) == n + 1;
+    }
+
+
+    index_type scan(index_type n) const noexcept {
+      while(published(n))
+        ++n;
+      return n;
+    }
+
+
+    T& operator [] (index_type n) noexcept {
+      return slots_[n & index_mask_].value;
+    }
+
+
+    T const& operator [] (index_type n) const noexcept {
+      return slots_[n & index_mask_].value;
+    }
+
+  private:
+
+    struct slot {
+      std::atomic<index_type> stamp;
+      T value;
+    };
+
+    index_type index_mask_{0};
+    std::unique_ptr<slot[]> slots_;
+
+  }; // stamped_availability
+
+
+  // Multi-producer ring which owns its events, Vyukov-style:
+  //
+  //   auto const index = ring.claim();
+  //   ring[index] = event;
+  //   ring.publish(index);
+  template<typename T, typename W = yielding_wait>
+  class stamped_ring_buffer : public basic_multisequencer<W, stamped_availability<T>> {
+  public:
+
+    using base = basic_multisequencer<W, stamped_availability<T>>;
+    using typename base::index_type;
+    using typename base::size_type;
+    using value_type = T;
+
+    stamped_ring_buffer() noexcept = default;
+    stamped_ring_buffer(stamped_ring_buffer&&) noexcept = default;
+    stamped_ring_buffer& operator = (stamped_ring_buffer&&) noexcept = default;
+
+    explicit stamped_ring_buffer(size_type capacity, W const& wait_strategy = W{}):
+      base{capacity, wait_strategy}
+    { }
+
+
+    T& operator [] (index_type n) noexcept {
+      return base::availability()[n];
+    }
+
+
+    T const& operator [] (index_type n) const noexcept {
+      return base::availability()[n];
+    }
+
+  }; // stamped_ring_buffer
+
+
+} // udisruptor
@@ -0,0 +1,266 @@
+/* This file is part of udisruptor library
+ * Copyright 2020 Andrei Ilin <ortfero@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "batch_event_processor.hpp"
+#include "barrier.hpp"
+#include "handler_group.hpp"
+#include "ring_buffer.hpp"
+#include "sequencer.hpp"
+
+
+namespace udisruptor {
+
+
+  // Wires batch_event_processors of handlers into a graph:
+  //
+  //   topology<event> graph{buffer, sequencer};
+  //   graph.handle_events_with(journal, replicate).then(business);
+  //   graph.start();
+  //
+  // Processors of a stage wait on a barrier depending on the stage before,
+  // and producers gate only on processors nothing runs after. Handlers,
+  // buffer and sequencer have to outlive the topology. The graph is built
+  // before producers start.
+  template<typename T, typename S = sequencer>
+  class topology {
+  public:
+
+    using size_type = sequence::value_type;
+    using barrier_type = basic_barrier<typename S::wait_strategy_type>;
+
+    static_assert(S::fixed_consumers == 0,
+                  "the last stage changes as the graph grows, "
+                  "which fixed consumer sets can't follow");
+
+    class group;
+
+    topology(topology const&) = delete;
+    topology& operator = (topology const&) = delete;
+
+
+    topology(ring_buffer<T>& buffer, S& sequencer, size_type commit_interval = 1):
+      buffer_{&buffer},
+      sequencer_{&sequencer},
+      commit_interval_{commit_interval}
+    { }
+
+
+    ~topology() {
+      halt();
+    }
+
+
+    // Processors which take events right from the sequencer
+    template<typename... H> group handle_events_with(H&... handlers) {
+      stages_.emplace_back();
+      auto& created = stages_.back();
+      group g{*this};
+      (g.members_.push_back(add<H>(created, *sequencer_, handlers, every_event{})), ...);
+      return g;
+    }
+
+
+    // Processors which share events of the sequencer by partition
+    template<typename H, typename P> group handle_events_with(handler_group<H, P> handlers) {
+      stages_.emplace_back();
+      group g{*this};
+      add_group(stages_.back(), *sequencer_, handlers, g);
+      return g;
+    }
+
+
+    // False if the sequencer refused to gate on some processor
+    explicit operator bool () const noexcept {
+      return ready_;
+    }
+
+
+    // Runs every processor in a thread of its own. Returns false and runs
+    // nothing unless the topology is ready.
+    bool start() {
+      if(!ready_)
+        return false;
+      if(running_)
+        return true;
+      running_ = true;
+      for(auto& s: stages_)
+        for(auto& n: s.nodes)
+          s.threads.emplace_back([p = n.get()] { p->run(); });
+      return true;
+    }
+
+
+    // Halts the sequencer and lets every stage drain what the stage before
+    // handled. Call when producers are done.
+    void halt() {
+      if(!running_)
+        return;
+      running_ = false;
+      sequencer_->halt();
+      for(auto& s: stages_) {
+        if(s.barrier)
+          s.barrier->halt();
+        join(s);
+      }
+    }
+
+
+    // Stops every processor at once
+    void alert() {
+      if(!running_)
+        return;
+      running_ = false;
+      sequencer_->alert();
+      for(auto& s: stages_)
+        if(s.barrier)
+          s.barrier->alert();
+      for(auto& s: stages_)
+        join(s);
+    }
+
+
+    class group {
+    public:
+
+      // Processors which take events once every member of the group
+      // handled them
+      template<typename... H> group then(H&... handlers) {
+        return owner_->then(*this, [&](stage& s, barrier_type& b, group& g) {
+          (g.members_.push_back(owner_->template add<H>(s, b, handlers, every_event{})), ...);
+        });
+      }
+
+
+      template<typename H, typename P> group then(handler_group<H, P> handlers) {
+        return owner_->then(*this, [&](stage& s, barrier_type& b, group& g) {
+          owner_->add_group(s, b, handlers, g);
+        });
+      }
+
+    private:
+
+      friend class topology;
+
+      topology* owner_;
+      std::vector<typename topology::node*> members_;
+
+      explicit group(topology& owner) noexcept:
+        owner_{&owner}
+      { }
+
+    }; // group
+
+  private:
+
+    struct node {
+      virtual ~node() = default;
+      virtual void run() = 0;
+      virtual sequence const& position() const noexcept = 0;
+      virtual void notifies(barrier_type& dependent) = 0;
+      virtual bool registered() const noexcept = 0;
+    }; // node
+
+
+    template<typename P> struct processor_node : node {
+
+      P processor;
+
+      template<typename... Args> explicit processor_node(Args&&... args):
+        processor{std::forward<Args>(args)...}
+      { }
+
+      void run() override { processor.run(); }
+      sequence const& position() const noexcept override { return processor.position(); }
+      void notifies(barrier_type& dependent) override { processor.notifies(dependent); }
+      bool registered() const noexcept override { return bool(processor); }
+
+    }; // processor_node
+
+
+    struct stage {
+      std::unique_ptr<barrier_type> barrier;
+      std::vector<std::unique_ptr<node>> nodes;
+      std::vector<std::thread> threads;
+    }; // stage
+
+
+    ring_buffer<T>* buffer_;
+    S* sequencer_;
+    size_type commit_interval_;
+    std::vector<stage> stages_;
+    bool ready_{true};
+    bool running_{false};
+
+
+    template<typename H, typename G, typename P>
+    node* add(stage& s, G& gate, H& handler, P partition) {
+      using processor_type = batch_event_processor<T, std::reference_wrapper<H>, S, G, P>;
+      s.nodes.push_back(std::make_unique<processor_node<processor_type>>(
+        *buffer_, *sequencer_, gate, std::ref(handler), commit_interval_,
+        std::move(partition)));
+      if(!s.nodes.back()->registered())
+        ready_ = false;
+      return s.nodes.back().get();
+    }
+
+
+    template<typename G, typename H, typename P>
+    void add_group(stage& s, G& gate, handler_group<H, P> const& handlers, group& g) {
+      for(size_type i = 0; i != handlers.members(); ++i)
+        g.members_.push_back(add(s, gate, (*handlers.handlers)[i], handlers.member(i)));
+    }
+
+
+    template<typename F> group then(group const& after, F&& add_members) {
+      stages_.emplace_back();
+      auto& created = stages_.back();
+      created.barrier = std::make_unique<barrier_type>();
+      for(auto member: after.members_) {
+        created.barrier->depends_on(member->position());
+        member->notifies(*created.barrier);
+      }
+      group g{*this};
+      add_members(created, *created.barrier, g);
+      // Whatever runs after a processor holds producers back already
+      for(auto member: after.members_)
+        sequencer_->remove_consumer(&member->position());
+      return g;
+    }
+
+
+    static void join(stage& s) {
+      for(auto& t: s.threads)
+        t.join();
+      s.threads.clear();
+    }
+
+  }; // topology
+
+
+} // udisruptor
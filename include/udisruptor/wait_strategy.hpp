@@ -0,0 +1,287 @@
+/* This file is part of udisruptor library
+ * Copyright 2020 Andrei Ilin <ortfero@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "eventcount.hpp"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+
+namespace udisruptor {
+
+
+  namespace detail {
+
+
+    inline void spin_pause() noexcept {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+      _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+      __asm__ __volatile__("yield");
+#endif
+    }
+
+
+  } // detail
+
+
+  // Wait strategies decide what a thread does while ready() is false.
+  // notify() is called by the side which makes ready() true.
+
+
+  class busy_spin_wait {
+  public:
+
+    template<typename F> void wait(F&& ready) {
+      while(!ready())
+        detail::spin_pause();
+    }
+
+
+    template<typename F, typename Clock, typename Duration>
+    bool wait_until(F&& ready, std::chrono::time_point<Clock, Duration> const& deadline) {
+      while(!ready()) {
+        if(Clock::now() >= deadline)
+          return false;
+        detail::spin_pause();
+      }
+      return true;
+    }
+
+
+    void notify() noexcept { }
+
+  }; // busy_spin_wait
+
+
+  class yielding_wait {
+  public:
+
+    template<typename F> void wait(F&& ready) {
+      while(!ready())
+        std::this_thread::yield();
+    }
+
+
+    template<typename F, typename Clock, typename Duration>
+    bool wait_until(F&& ready, std::chrono::time_point<Clock, Duration> const& deadline) {
+      while(!ready()) {
+        if(Clock::now() >= deadline)
+          return false;
+        std::this_thread::yield();
+      }
+      return true;
+    }
+
+
+    void notify() noexcept { }
+
+  }; // yielding_wait
+
+
+  class phased_backoff_wait {
+  public:
+
+    phased_backoff_wait() noexcept = default;
+
+
+    phased_backoff_wait(unsigned spins, unsigned yields,
+                        std::chrono::nanoseconds sleep) noexcept:
+      spins_{spins}, yields_{yields}, sleep_{sleep}
+    { }
+
+
+    template<typename F> void wait(F&& ready) {
+      for(unsigned i = 0; i != spins_; ++i) {
+        if(ready())
+          return;
+        detail::spin_pause();
+      }
+      for(unsigned i = 0; i != yields_; ++i) {
+        if(ready())
+          return;
+        std::this_thread::yield();
+      }
+      while(!ready())
+        std::this_thread::sleep_for(sleep_);
+    }
+
+
+    template<typename F, typename Clock, typename Duration>
+    bool wait_until(F&& ready, std::chrono::time_point<Clock, Duration> const& deadline) {
+      for(unsigned i = 0; i != spins_; ++i) {
+        if(ready())
+          return true;
+        detail::spin_pause();
+      }
+      for(unsigned i = 0; i != yields_; ++i) {
+        if(ready())
+          return true;
+        if(Clock::now() >= deadline)
+          return false;
+        std::this_thread::yield();
+      }
+      while(!ready()) {
+        auto const now = Clock::now();
+        if(now >= deadline)
+          return false;
+        if(deadline - now < sleep_)
+          std::this_thread::sleep_until(deadline);
+        else
+          std::this_thread::sleep_for(sleep_);
+      }
+      return true;
+    }
+
+
+    void notify() noexcept { }
+
+  private:
+
+    unsigned spins_{1000};
+    unsigned yields_{100};
+    std::chrono::nanoseconds sleep_{std::chrono::microseconds{50}};
+
+  }; // phased_backoff_wait
+
+
+  // Parks on a condition variable. Waiters also wake up every park timeout
+  // to recheck ready(), so a missed notify() costs latency, not progress.
+  class blocking_wait {
+  public:
+
+    blocking_wait() noexcept = default;
+
+    explicit blocking_wait(std::chrono::nanoseconds park_timeout) noexcept:
+      park_timeout_{park_timeout}
+    { }
+
+    blocking_wait(blocking_wait const& other) noexcept:
+      park_timeout_{other.park_timeout_}
+    { }
+
+    blocking_wait& operator = (blocking_wait const& other) noexcept {
+      park_timeout_ = other.park_timeout_;
+      return *this;
+    }
+
+
+    template<typename F> void wait(F&& ready) {
+      if(ready())
+        return;
+      std::unique_lock<std::mutex> lock{mutex_};
+      while(!ready())
+        condition_.wait_for(lock, park_timeout_);
+    }
+
+
+    template<typename F, typename Clock, typename Duration>
+    bool wait_until(F&& ready, std::chrono::time_point<Clock, Duration> const& deadline) {
+      if(ready())
+        return true;
+      std::unique_lock<std::mutex> lock{mutex_};
+      while(!ready()) {
+        auto const now = Clock::now();
+        if(now >= deadline)
+          return false;
+        if(deadline - now < park_timeout_)
+          condition_.wait_until(lock, deadline);
+        else
+          condition_.wait_for(lock, park_timeout_);
+      }
+      return true;
+    }
+
+
+    void notify() {
+      std::lock_guard<std::mutex> lock{mutex_};
+      condition_.notify_all();
+    }
+
+  private:
+
+    std::chrono::nanoseconds park_timeout_{std::chrono::milliseconds{1}};
+    std::mutex mutex_;
+    std::condition_variable condition_;
+
+  }; // blocking_wait
+
+
+  // Parks in the kernel like blocking_wait, but notify() only issues
+  // a wake up when some thread is actually parked
+  class parking_wait {
+  public:
+
+    parking_wait() noexcept = default;
+    parking_wait(parking_wait const&) noexcept { }
+    parking_wait& operator = (parking_wait const&) noexcept { return *this; }
+
+
+    template<typename F> void wait(F&& ready) {
+      while(!ready()) {
+        auto const key = events_.prepare_wait();
+        if(ready()) {
+          events_.cancel_wait();
+          return;
+        }
+        events_.commit_wait(key);
+      }
+    }
+
+
+    template<typename F, typename Clock, typename Duration>
+    bool wait_until(F&& ready, std::chrono::time_point<Clock, Duration> const& deadline) {
+      while(!ready()) {
+        auto const key = events_.prepare_wait();
+        if(ready()) {
+          events_.cancel_wait();
+          return true;
+        }
+        if(!events_.commit_wait_until(key, deadline))
+          return ready();
+      }
+      return true;
+    }
+
+
+    void notify() noexcept {
+      events_.notify_all();
+    }
+
+  private:
+
+    eventcount events_;
+
+  }; // parking_wait
+
+
+} // udisruptor
@@ -0,0 +1,209 @@
+/* This file is part of udisruptor library
+ * Copyright 2020 Andrei Ilin <ortfero@gmail.com>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+
+#include <atomic>
+#include <limits>
+#include <thread>
+#include <vector>
+#include "ring_buffer.hpp"
+#include "sequence.hpp"
+#include "sequencer.hpp"
+
+
+namespace udisruptor {
+
+
+  // Workers sharing one ring, each event is handled by exactly one of them.
+  // A worker claims up to batch published events with one CAS on the work
+  // sequence and calls handler(T&, index, end_of_batch) for each. Producers
+  // gate on a single sequence of the pool's progress, the highest index
+  // below which every event is handled. Every worker has a copy of handler.
+  template<typename T, typename H, typename S = sequencer>
+  class worker_pool {
+  public:
+
+    using index_type = sequence::value_type;
+    using size_type = sequence::value_type;
+    using handler_type = H;
+
+    static_assert(S::fixed_consumers == 0,
+                  "producers gate on a progress sequence of the pool, "
+                  "which fixed consumer sets can't hold");
+
+    worker_pool(worker_pool const&) = delete;
+    worker_pool& operator = (worker_pool const&) = delete;
+
+
+    worker_pool(ring_buffer<T>& buffer, S& sequencer, size_type workers,
+                size_type batch = 64, H const& handler = H{}):
+      buffer_{&buffer},
+      sequencer_{&sequencer},
+      batch_{batch < 1 ? 1 : batch},
+      registered_{sequencer.add_consumer(progress_)} {
+      work_ = progress_.value() + 1;
+      workers_.reserve(workers);
+      for(size_type i = 0; i != workers; ++i)
+        workers_.push_back(worker{sequence{idle}, handler});
+    }
+
+
+    ~worker_pool() {
+      halt();
+      sequencer_->remove_consumer(&progress_);
+    }
+
+
+    // False if the sequencer refused to gate on the pool
+    explicit operator bool () const noexcept {
+      return registered_;
+    }
+
+
+    // Runs every worker in a thread of its own
+    void start() {
+      if(!threads_.empty())
+        return;
+      for(size_type i = 0; i != size_type(workers_.size()); ++i)
+        threads_.emplace_back([this, i] { run(workers_[i]); });
+    }
+
+
+    // Halts the sequencer and waits until workers handled everything
+    // published. Call when producers are done.
+    void halt() {
+      if(threads_.empty())
+        return;
+      sequencer_->halt();
+      join();
+    }
+
+
+    // Stops workers at once
+    void alert() {
+      if(threads_.empty())
+        return;
+      sequencer_->alert();
+      join();
+    }
+
+
+    sequence const& progress() const noexcept {
+      return progress_;
+    }
+
+
+    size_type workers() const noexcept {
+      return size_type(workers_.size());
+    }
+
+
+    H& handler(size_type worker) noexcept {
+      return workers_[worker].handler;
+    }
+
+  private:
+
+    static constexpr index_type idle = std::numeric_limits<index_type>::max();
+
+    struct worker {
+      // Index before the first one claimed, idle when nothing is claimed
+      sequence busy;
+      H handler;
+    }; // worker
+
+    sequence progress_;
+    sequence work_;
+    ring_buffer<T>* buffer_;
+    S* sequencer_;
+    size_type batch_;
+    bool registered_;
+    std::vector<worker> workers_;
+    std::vector<std::thread> threads_;
+
+
+    void run(worker& w) {
+      // Highest index known to be published, so that claims smaller than
+      // what is published do not scan availability again
+      auto published = sequence::invalid;
+      for(;;) {
+        auto first = work_.value();
+        if(published < first) {
+          published = sequencer_->try_fetch_all(first) - 1;
+          if(published < first) {
+            published = sequencer_->wait_for(first);
+            if(published < first)
+              return;
+          }
+        }
+        auto last = published;
+        if(last - first >= batch_)
+          last = first + batch_ - 1;
+        // Keeps the claim covered while the work sequence moves past it
+        w.busy.store(first - 1);
+        if(!work_.compare_exchange(first, last + 1)) {
+          // Another worker may have taken the failed claim into progress
+          w.busy.lazy_store(idle);
+          if(advance())
+            sequencer_->notify_consumed();
+          continue;
+        }
+        for(auto i = first; i != last; ++i)
+          w.handler((*buffer_)[i], i, false);
+        w.handler((*buffer_)[last], last, true);
+        w.busy.lazy_store(idle);
+        if(advance())
+          sequencer_->notify_consumed();
+      }
+    }
+
+
+    // Either this worker sees the claim of another one or the other one
+    // claimed after work_ was read here
+    bool advance() noexcept {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      auto minimum = work_.value() - 1;
+      for(auto const& w: workers_) {
+        auto const m = w.busy.value();
+        if(m < minimum)
+          minimum = m;
+      }
+      auto current = progress_.value();
+      while(current < minimum)
+        if(progress_.compare_exchange(current, minimum))
+          return true;
+      return false;
+    }
+
+
+    void join() {
+      for(auto& t: threads_)
+        t.join();
+      threads_.clear();
+    }
+
+  }; // worker_pool
+
+
+} // udisruptor
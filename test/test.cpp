@@ -3,8 +3,1446 @@
 
 #include <udisruptor/sequence.hpp>
 #include <udisruptor/ring_buffer.hpp>
+#include <udisruptor/sequencer.hpp>
+#include <udisruptor/multisequencer.hpp>
+#include <udisruptor/stamped_ring_buffer.hpp>
+#include <udisruptor/cursor_availability.hpp>
+#include <udisruptor/multilane_ring_buffer.hpp>
+#include <udisruptor/staging_producer.hpp>
+#include <udisruptor/claim_combiner.hpp>
+#include <udisruptor/gating_tree.hpp>
+#include <udisruptor/barrier.hpp>
+#include <udisruptor/eventcount.hpp>
+#include <udisruptor/batch_event_processor.hpp>
+#include <udisruptor/topology.hpp>
+#include <udisruptor/handler_group.hpp>
+#include <udisruptor/worker_pool.hpp>
+
+#include <thread>
+#include <vector>
+#include <set>
+#include <memory>
+#include <atomic>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <udisruptor/eventfd_notifier.hpp>
+#endif
 
 
 TEST_CASE("") {
 }
 
+
+TEST_CASE_TEMPLATE("batch claim/publish", S,
+                   udisruptor::sequencer, udisruptor::multisequencer) {
+  S sequencer{16};
+  auto consumer_seq = sequencer.add_consumer();
+  REQUIRE(!!sequencer);
+
+  REQUIRE(sequencer.claim(0) == udisruptor::sequence::invalid);
+  REQUIRE(sequencer.claim(17) == udisruptor::sequence::invalid);
+
+  auto const lo = sequencer.claim(10);
+  REQUIRE(lo == 0);
+  REQUIRE(sequencer.try_fetch_all(consumer_seq->next()) == 0);
+
+  sequencer.publish(lo, lo + 9);
+  REQUIRE(sequencer.try_fetch_all(consumer_seq->next()) == 10);
+  *consumer_seq = 9;
+
+  REQUIRE(sequencer.claim() == 10);
+  sequencer.publish(10);
+  REQUIRE(sequencer.try_fetch_all(consumer_seq->next()) == 11);
+}
+
+
+TEST_CASE_TEMPLATE("try_claim/claim_until on a full ring", S,
+                   udisruptor::sequencer, udisruptor::multisequencer) {
+  using namespace std::chrono;
+  S sequencer{4};
+  auto consumer_seq = sequencer.add_consumer();
+
+  REQUIRE(sequencer.try_claim(3) == 0);
+  REQUIRE(sequencer.try_claim() == 3);
+  sequencer.publish(0, 3);
+  REQUIRE(sequencer.try_claim() == udisruptor::sequence::invalid);
+
+  auto const deadline = steady_clock::now() + milliseconds{1};
+  REQUIRE(sequencer.claim_until(deadline) == udisruptor::sequence::invalid);
+  REQUIRE(steady_clock::now() >= deadline);
+
+  *consumer_seq = 1;
+  REQUIRE(sequencer.try_claim(3) == udisruptor::sequence::invalid);
+  REQUIRE(sequencer.claim_until(2, steady_clock::now()) == 4);
+  REQUIRE(sequencer.try_claim() == udisruptor::sequence::invalid);
+}
+
+
+TEST_CASE("producer handles keep their own gating cache") {
+  udisruptor::multisequencer sequencer{4};
+  auto consumer_seq = sequencer.add_consumer();
+  auto first = sequencer.make_producer();
+  auto second = sequencer.make_producer();
+
+  REQUIRE(first.try_claim(3) == 0);
+  REQUIRE(second.try_claim() == 3);
+  first.publish(0, 2);
+  second.publish(3);
+  REQUIRE(first.try_claim() == udisruptor::sequence::invalid);
+
+  *consumer_seq = 1;
+  REQUIRE(second.try_claim(2) == 4);
+  REQUIRE(first.try_claim() == udisruptor::sequence::invalid);
+  REQUIRE(sequencer.try_claim() == udisruptor::sequence::invalid);
+  second.publish(4, 5);
+  REQUIRE(sequencer.try_fetch_all(2) == 6);
+}
+
+
+TEST_CASE("barrier waits for the slowest dependency") {
+  udisruptor::sequence first{5}, second{3};
+  udisruptor::barrier barrier;
+  REQUIRE(barrier.wait(7) == 7);
+
+  barrier.depends_on(first);
+  barrier.depends_on(second);
+  REQUIRE(barrier.wait(2) == 3);
+
+  auto updater = std::thread{[&] {
+    first = 8;
+    second = 9;
+  }};
+  REQUIRE(barrier.wait(6) == 8);
+  updater.join();
+}
+
+
+TEST_CASE_TEMPLATE("producer gated by a slow consumer", W,
+                   udisruptor::busy_spin_wait, udisruptor::yielding_wait,
+                   udisruptor::phased_backoff_wait, udisruptor::blocking_wait,
+                   udisruptor::parking_wait) {
+  constexpr auto events_count = 1000;
+  udisruptor::ring_buffer<int64_t> buffer{8};
+  udisruptor::basic_sequencer<W> sequencer{buffer.capacity()};
+  auto consumer_seq = sequencer.add_consumer();
+
+  auto mismatches = 0;
+  auto consumer = std::thread{[&] {
+    auto next = consumer_seq->next();
+    while(next != events_count) {
+      auto const until = sequencer.try_fetch_all(next);
+      for(; next != until; ++next)
+        if(buffer[next] != next)
+          ++mismatches;
+      sequencer.commit(*consumer_seq, until - 1);
+      std::this_thread::yield();
+    }
+  }};
+
+  for(auto i = 0; i != events_count; ++i) {
+    auto const index = sequencer.claim();
+    buffer[index] = index;
+    sequencer.publish(index);
+  }
+
+  consumer.join();
+  REQUIRE(mismatches == 0);
+  REQUIRE(consumer_seq->value() == events_count - 1);
+}
+
+
+TEST_CASE_TEMPLATE("consumer waits for published events", S,
+                   udisruptor::sequencer, udisruptor::multisequencer,
+                   udisruptor::basic_sequencer<udisruptor::blocking_wait>,
+                   udisruptor::basic_multisequencer<udisruptor::phased_backoff_wait>,
+                   udisruptor::basic_sequencer<udisruptor::parking_wait>,
+                   udisruptor::basic_multisequencer<udisruptor::parking_wait>) {
+  constexpr auto events_count = 1000;
+  udisruptor::ring_buffer<int64_t> buffer{64};
+  S sequencer{buffer.capacity()};
+  auto consumer_seq = sequencer.add_consumer();
+
+  auto mismatches = 0;
+  auto consumer = std::thread{[&] {
+    while(consumer_seq->next() != events_count) {
+      auto const next = consumer_seq->next();
+      auto const last = sequencer.wait_for(next);
+      for(auto i = next; i <= last; ++i)
+        if(buffer[i] != i)
+          ++mismatches;
+      sequencer.commit(*consumer_seq, last);
+    }
+  }};
+
+  for(auto i = 0; i != events_count / 2; ++i) {
+    auto const index = sequencer.claim();
+    buffer[index] = index;
+    sequencer.publish(index);
+  }
+
+  for(auto i = 0; i != events_count / 2; i += 10) {
+    auto const first = sequencer.claim(10);
+    for(auto j = first; j != first + 10; ++j)
+      buffer[j] = j;
+    sequencer.publish(first, first + 9);
+  }
+
+  consumer.join();
+  REQUIRE(mismatches == 0);
+}
+
+
+TEST_CASE("eventcount") {
+  using namespace std::chrono;
+  udisruptor::eventcount events;
+  events.notify_all();
+
+  auto key = events.prepare_wait();
+  REQUIRE(!events.commit_wait_until(key, steady_clock::now() + milliseconds{1}));
+
+  std::atomic<bool> ready{false};
+  auto notifier = std::thread{[&] {
+    ready = true;
+    events.notify_all();
+  }};
+  while(!ready) {
+    key = events.prepare_wait();
+    if(ready)
+      events.cancel_wait();
+    else
+      events.commit_wait(key);
+  }
+  notifier.join();
+  REQUIRE(ready);
+}
+
+
+#if defined(__linux__)
+
+TEST_CASE_TEMPLATE("eventfd notifier signals once per burst", S,
+                   udisruptor::sequencer, udisruptor::multisequencer) {
+  S sequencer{16};
+  auto consumer_seq = sequencer.add_consumer();
+  udisruptor::eventfd_notifier notifier;
+  REQUIRE(!!notifier);
+  sequencer.add_notifier(notifier);
+
+  auto const readable = [&] {
+    pollfd fds{notifier.fd(), POLLIN, 0};
+    return ::poll(&fds, 1, 0) == 1;
+  };
+
+  sequencer.publish(sequencer.claim());
+  REQUIRE(!readable());
+  REQUIRE(!sequencer.arm(notifier, consumer_seq->next()));
+
+  *consumer_seq = sequencer.try_fetch_all(consumer_seq->next()) - 1;
+  REQUIRE(sequencer.arm(notifier, consumer_seq->next()));
+
+  for(auto i = 0; i != 5; ++i)
+    sequencer.publish(sequencer.claim());
+  REQUIRE(readable());
+
+  uint64_t signals = 0;
+  REQUIRE(::read(notifier.fd(), &signals, sizeof(signals)) == sizeof(signals));
+  REQUIRE(signals == 1);
+  REQUIRE(!readable());
+}
+
+#endif
+
+
+TEST_CASE_TEMPLATE("halt drains consumers and stops producers", S,
+                   udisruptor::basic_sequencer<udisruptor::parking_wait>,
+                   udisruptor::basic_multisequencer<udisruptor::parking_wait>) {
+  S sequencer{8};
+  auto consumer_seq = sequencer.add_consumer();
+
+  for(auto i = 0; i != 3; ++i)
+    sequencer.publish(sequencer.claim());
+
+  auto consumed = 0;
+  auto consumer = std::thread{[&] {
+    for(;;) {
+      auto const next = consumer_seq->next();
+      auto const last = sequencer.wait_for(next);
+      if(last == udisruptor::sequence::alerted)
+        break;
+      consumed += int(last - next + 1);
+      sequencer.commit(*consumer_seq, last);
+    }
+  }};
+
+  while(consumer_seq->value() != 2)
+    std::this_thread::yield();
+  sequencer.publish(sequencer.claim());
+  sequencer.halt();
+  consumer.join();
+
+  REQUIRE(consumed == 4);
+  REQUIRE(sequencer.claim() == udisruptor::sequence::alerted);
+  REQUIRE(sequencer.try_claim() == udisruptor::sequence::alerted);
+
+  sequencer.resume();
+  REQUIRE(sequencer.claim() == 4);
+}
+
+
+TEST_CASE_TEMPLATE("alert wakes gated producers", S,
+                   udisruptor::basic_sequencer<udisruptor::parking_wait>,
+                   udisruptor::basic_multisequencer<udisruptor::parking_wait>) {
+  S sequencer{2};
+  auto consumer_seq = sequencer.add_consumer();
+  sequencer.publish(sequencer.claim(2));
+
+  auto claimed = udisruptor::sequence::invalid;
+  auto producer = std::thread{[&] { claimed = sequencer.claim(); }};
+  std::this_thread::sleep_for(std::chrono::milliseconds{1});
+  sequencer.alert();
+  producer.join();
+
+  REQUIRE(claimed == udisruptor::sequence::alerted);
+  REQUIRE(sequencer.wait_for(consumer_seq->next()) == udisruptor::sequence::alerted);
+}
+
+
+TEST_CASE_TEMPLATE("interrupted claims leave no hole behind", S,
+                   udisruptor::basic_sequencer<udisruptor::parking_wait>,
+                   udisruptor::basic_multisequencer<udisruptor::parking_wait>) {
+  S sequencer{4};
+  auto consumer_seq = sequencer.add_consumer();
+  REQUIRE(sequencer.claim(4) == 0);
+  sequencer.publish(0, 3);
+
+  auto claimed = udisruptor::sequence::invalid;
+  auto producer = std::thread{[&] { claimed = sequencer.claim(); }};
+  std::this_thread::sleep_for(std::chrono::milliseconds{1});
+  sequencer.halt();
+  producer.join();
+  REQUIRE(claimed == udisruptor::sequence::alerted);
+
+  sequencer.resume();
+  sequencer.commit(*consumer_seq, 3);
+  REQUIRE(sequencer.claim() == 4);
+  sequencer.publish(4);
+  REQUIRE(sequencer.wait_for(consumer_seq->next()) == 4);
+  REQUIRE(sequencer.try_fetch_all(4) == 5);
+}
+
+
+TEST_CASE("interrupted combined claims leave no hole behind") {
+  using S = udisruptor::basic_multisequencer<udisruptor::parking_wait>;
+  S sequencer{4};
+  auto consumer_seq = sequencer.add_consumer();
+  udisruptor::claim_combiner<S> combiner{sequencer, 1, 4};
+  auto producer = combiner.add_producer();
+  REQUIRE(producer.claim(4) == 0);
+  producer.publish(0, 3);
+
+  auto claimed = udisruptor::sequence::invalid;
+  auto thread = std::thread{[&] { claimed = producer.claim(); }};
+  std::this_thread::sleep_for(std::chrono::milliseconds{1});
+  sequencer.halt();
+  thread.join();
+  REQUIRE(claimed == udisruptor::sequence::alerted);
+
+  sequencer.resume();
+  sequencer.commit(*consumer_seq, 3);
+  REQUIRE(producer.claim() == 4);
+  producer.publish(4);
+  REQUIRE(sequencer.wait_for(consumer_seq->next()) == 4);
+}
+
+
+TEST_CASE("barrier alert and halt") {
+  udisruptor::sequence dependency{3};
+  udisruptor::basic_barrier<udisruptor::parking_wait> barrier;
+  barrier.depends_on(dependency);
+
+  auto waited = udisruptor::sequence::invalid;
+  auto consumer = std::thread{[&] { waited = barrier.wait(4); }};
+  std::this_thread::sleep_for(std::chrono::milliseconds{1});
+  barrier.halt();
+  consumer.join();
+
+  REQUIRE(waited == udisruptor::sequence::alerted);
+  REQUIRE(barrier.wait(2) == 3);
+
+  barrier.alert();
+  REQUIRE(barrier.wait(2) == udisruptor::sequence::alerted);
+  barrier.resume();
+  REQUIRE(barrier.wait(2) == 3);
+}
+
+
+TEST_CASE_TEMPLATE("multiple producers and consumers stress", S,
+                   udisruptor::multisequencer,
+                   udisruptor::basic_multisequencer<udisruptor::parking_wait>,
+                   udisruptor::basic_multisequencer<udisruptor::yielding_wait,
+                                                    udisruptor::cooperative_cursor<>>,
+                   udisruptor::basic_multisequencer<udisruptor::yielding_wait,
+                                                    udisruptor::ordered_cursor<>>,
+                   udisruptor::basic_multisequencer<udisruptor::yielding_wait,
+                                                    udisruptor::sequence_availability, 2>) {
+  constexpr auto producers_count = 3;
+  constexpr auto consumers_count = 2;
+  constexpr auto events_per_producer = 3000;
+  constexpr auto events_count = producers_count * events_per_producer;
+
+  udisruptor::ring_buffer<int64_t> buffer{64};
+  S sequencer{buffer.capacity()};
+  std::vector<udisruptor::sequence*> consumer_seqs;
+  for(auto i = 0; i != consumers_count; ++i)
+    consumer_seqs.push_back(sequencer.add_consumer());
+
+  std::atomic<int> mismatches{0};
+  std::vector<std::thread> threads;
+  for(auto consumer_seq: consumer_seqs)
+    threads.emplace_back([&, consumer_seq] {
+      auto consumed = 0;
+      for(;;) {
+        auto const next = consumer_seq->next();
+        auto const last = sequencer.wait_for(next);
+        if(last == udisruptor::sequence::alerted)
+          break;
+        for(auto i = next; i <= last; ++i, ++consumed)
+          if(buffer[i] != i)
+            ++mismatches;
+        sequencer.commit(*consumer_seq, last);
+      }
+      if(consumed != events_count)
+        ++mismatches;
+    });
+
+  std::vector<std::thread> producers;
+  for(auto p = 0; p != producers_count; ++p)
+    producers.emplace_back([&, p] {
+      auto handle = sequencer.make_producer();
+      for(auto i = 0; i != events_per_producer;) {
+        if(p == 0) {
+          auto const first = sequencer.claim(5);
+          for(auto j = first; j != first + 5; ++j)
+            buffer[j] = j;
+          sequencer.publish(first, first + 4);
+          i += 5;
+        } else if(p == 1) {
+          auto const first = handle.claim(3);
+          for(auto j = first; j != first + 3; ++j)
+            buffer[j] = j;
+          handle.publish(first, first + 2);
+          i += 3;
+        } else {
+          auto const index = sequencer.claim();
+          buffer[index] = index;
+          sequencer.publish(index);
+          ++i;
+        }
+      }
+    });
+
+  for(auto& producer: producers)
+    producer.join();
+  sequencer.halt();
+  for(auto& thread: threads)
+    thread.join();
+
+  REQUIRE(mismatches == 0);
+}
+
+
+TEST_CASE_TEMPLATE("availability encodings", A,
+                   udisruptor::sequence_availability,
+                   udisruptor::lap_availability<uint32_t>,
+                   udisruptor::lap_availability<uint8_t>,
+                   udisruptor::parity_availability,
+                   udisruptor::stamped_availability<int64_t>,
+                   udisruptor::cooperative_cursor<>,
+                   udisruptor::scrambled_availability) {
+  for(auto capacity: {16, 256}) {
+    udisruptor::basic_multisequencer<udisruptor::yielding_wait, A> sequencer{capacity};
+    auto consumer_seq = sequencer.add_consumer();
+
+    for(auto lap = 0; lap != 300; ++lap) {
+      auto const next = consumer_seq->next();
+      REQUIRE(sequencer.try_fetch(next) == udisruptor::sequence::invalid);
+
+      auto const first = sequencer.claim(capacity / 2);
+      auto const second = sequencer.claim(capacity / 2 - 1);
+      auto const third = sequencer.claim();
+      sequencer.publish(second, second + capacity / 2 - 2);
+      REQUIRE(sequencer.try_fetch_all(next) == next);
+
+      sequencer.publish(first, first + capacity / 2 - 1);
+      REQUIRE(sequencer.try_fetch_all(next) == third);
+
+      sequencer.publish(third);
+      REQUIRE(sequencer.try_fetch_all(next) == next + capacity);
+      REQUIRE(sequencer.wait_for(next) == next + capacity - 1);
+      *consumer_seq = next + capacity - 1;
+    }
+  }
+}
+
+
+TEST_CASE_TEMPLATE("availability scan stops at the first unpublished slot", A,
+                   udisruptor::sequence_availability,
+                   udisruptor::lap_availability<uint32_t>,
+                   udisruptor::lap_availability<uint8_t>,
+                   udisruptor::parity_availability,
+                   udisruptor::stamped_availability<int64_t>,
+                   udisruptor::cooperative_cursor<>,
+                   udisruptor::scrambled_availability) {
+  constexpr auto capacity = 128;
+  udisruptor::basic_multisequencer<udisruptor::yielding_wait, A> sequencer{capacity};
+  auto consumer_seq = sequencer.add_consumer();
+
+  for(auto hole = 0; hole != capacity - 2; ++hole) {
+    auto const next = consumer_seq->next();
+    auto const first = sequencer.claim(capacity - hole % 3);
+    auto const last = first + capacity - hole % 3 - 1;
+    if(hole != 0)
+      sequencer.publish(first, first + hole - 1);
+    if(first + hole != last)
+      sequencer.publish(first + hole + 1, last);
+    REQUIRE(sequencer.try_fetch_all(next) == first + hole);
+
+    sequencer.publish(first + hole);
+    REQUIRE(sequencer.try_fetch_all(next) == last + 1);
+    *consumer_seq = last;
+  }
+}
+
+
+TEST_CASE("stamped ring buffer") {
+  constexpr auto producers_count = 3;
+  constexpr auto events_per_producer = 3000;
+  constexpr auto events_count = producers_count * events_per_producer;
+
+  udisruptor::stamped_ring_buffer<int64_t> ring{64};
+  auto consumer_seq = ring.add_consumer();
+  REQUIRE(!!ring);
+
+  std::atomic<int> mismatches{0};
+  auto consumer = std::thread{[&] {
+    auto consumed = 0;
+    for(;;) {
+      auto const next = consumer_seq->next();
+      auto const last = ring.wait_for(next);
+      if(last == udisruptor::sequence::alerted)
+        break;
+      for(auto i = next; i <= last; ++i, ++consumed)
+        if(ring[i] != i)
+          ++mismatches;
+      ring.commit(*consumer_seq, last);
+    }
+    if(consumed != events_count)
+      ++mismatches;
+  }};
+
+  std::vector<std::thread> producers;
+  for(auto p = 0; p != producers_count; ++p)
+    producers.emplace_back([&] {
+      for(auto i = 0; i != events_per_producer; ++i) {
+        auto const index = ring.claim();
+        ring[index] = index;
+        ring.publish(index);
+      }
+    });
+
+  for(auto& producer: producers)
+    producer.join();
+  ring.halt();
+  consumer.join();
+
+  REQUIRE(mismatches == 0);
+}
+
+
+TEST_CASE_TEMPLATE("barrier gates on cursor", A,
+                   udisruptor::cooperative_cursor<udisruptor::lap_availability<uint8_t>>,
+                   udisruptor::ordered_cursor<>) {
+  udisruptor::basic_multisequencer<udisruptor::yielding_wait, A> sequencer{16};
+  sequencer.add_consumer();
+  udisruptor::barrier barrier;
+  barrier.depends_on(sequencer.cursor());
+
+  auto const first = sequencer.claim(2);
+  auto const second = sequencer.claim(3);
+  REQUIRE(sequencer.cursor().value() == first - 1);
+
+  auto producer = std::thread{[&] { sequencer.publish(second, second + 2); }};
+  sequencer.publish(first, first + 1);
+  REQUIRE(barrier.wait(second + 2) == second + 2);
+  producer.join();
+  REQUIRE(sequencer.try_fetch_all(first) == second + 3);
+}
+
+
+TEST_CASE("alert frees producers waiting to publish in claim order") {
+  using namespace std::chrono;
+  udisruptor::basic_multisequencer<udisruptor::parking_wait,
+                                   udisruptor::ordered_cursor<>> sequencer{8};
+  sequencer.add_consumer();
+  auto const first = sequencer.claim();
+  auto const second = sequencer.claim();
+
+  // A halt still lets the earlier claim be published
+  auto producer = std::thread{[&] { sequencer.publish(second); }};
+  std::this_thread::sleep_for(milliseconds{1});
+  sequencer.halt();
+  std::this_thread::sleep_for(milliseconds{1});
+  auto const halted = sequencer.cursor().value();
+  sequencer.publish(first);
+  producer.join();
+  REQUIRE(halted == udisruptor::sequence::invalid);
+  REQUIRE(sequencer.cursor().value() == second);
+
+  sequencer.resume();
+  sequencer.claim();
+  auto const fourth = sequencer.claim();
+  producer = std::thread{[&] { sequencer.publish(fourth); }};
+  std::this_thread::sleep_for(milliseconds{1});
+  sequencer.alert();
+  producer.join();
+  REQUIRE(sequencer.cursor().value() == second);
+}
+
+
+TEST_CASE_TEMPLATE("multilane ring buffer keeps order within lanes", W,
+                   udisruptor::yielding_wait, udisruptor::parking_wait) {
+  constexpr auto producers_count = 3;
+  constexpr auto events_per_producer = 3000;
+
+  udisruptor::multilane_ring_buffer<int64_t, W> ring{producers_count, 16};
+  auto consumer = ring.add_consumer();
+  REQUIRE(!!ring);
+  REQUIRE(ring.lanes() == producers_count);
+
+  int64_t last[producers_count] = {-1, -1, -1};
+  auto consumed = 0, mismatches = 0;
+  auto consumer_thread = std::thread{[&] {
+    for(;;) {
+      auto const handled = ring.drain(consumer, [&](int64_t event) {
+        auto const p = event / events_per_producer;
+        if(event % events_per_producer != last[p] + 1)
+          ++mismatches;
+        last[p] = event % events_per_producer;
+        ++consumed;
+      }, 5);
+      if(handled == udisruptor::sequence::alerted)
+        break;
+      if(handled > 5 * producers_count)
+        ++mismatches;
+    }
+  }};
+
+  std::vector<std::thread> producers;
+  for(auto p = 0; p != producers_count; ++p)
+    producers.emplace_back([&, p] {
+      auto& lane = ring.producer(p);
+      for(auto i = 0; i != events_per_producer; ++i) {
+        auto const index = lane.claim();
+        lane[index] = p * events_per_producer + i;
+        lane.publish(index);
+      }
+    });
+
+  for(auto& producer: producers)
+    producer.join();
+  ring.halt();
+  consumer_thread.join();
+
+  REQUIRE(mismatches == 0);
+  REQUIRE(consumed == producers_count * events_per_producer);
+  REQUIRE(ring.producer(0).claim() == udisruptor::sequence::alerted);
+}
+
+
+TEST_CASE("staging producer flushes by size and delay") {
+  using namespace std::chrono;
+  udisruptor::ring_buffer<int64_t> buffer{16};
+  udisruptor::multisequencer sequencer{buffer.capacity()};
+  auto consumer_seq = sequencer.add_consumer();
+  auto handle = sequencer.make_producer();
+  udisruptor::staging_producer<int64_t, decltype(handle)> producer{
+    buffer, handle, 4, milliseconds{1}};
+
+  for(auto i = 0; i != 10; ++i)
+    REQUIRE(producer.push(i));
+  REQUIRE(producer.size() == 2);
+  REQUIRE(sequencer.try_fetch_all(0) == 8);
+
+  REQUIRE(producer.poll());
+  REQUIRE(producer.size() == 2);
+  std::this_thread::sleep_for(milliseconds{2});
+  REQUIRE(producer.poll());
+  REQUIRE(producer.size() == 0);
+  REQUIRE(sequencer.try_fetch_all(0) == 10);
+  for(auto i = 0; i != 10; ++i)
+    REQUIRE(buffer[i] == i);
+  *consumer_seq = 9;
+
+  sequencer.halt();
+  for(auto i = 0; i != 4; ++i)
+    REQUIRE(producer.push(i));
+  REQUIRE(!producer.push(4));
+  REQUIRE(producer.size() == 4);
+  REQUIRE(!producer.flush());
+}
+
+
+struct batch_recorder {
+  std::vector<int64_t> events;
+  int batches{0};
+
+  void operator () (int64_t& event, int64_t, bool end_of_batch) {
+    events.push_back(event);
+    if(end_of_batch)
+      ++batches;
+  }
+};
+
+
+TEST_CASE_TEMPLATE("batch event processor signals end of batch", S,
+                   udisruptor::sequencer, udisruptor::multisequencer) {
+  udisruptor::ring_buffer<int64_t> buffer{8};
+  S sequencer{buffer.capacity()};
+  udisruptor::batch_event_processor<int64_t, batch_recorder, S> processor{
+    buffer, sequencer, batch_recorder{}, 4};
+  REQUIRE(!!processor);
+  REQUIRE(processor.poll() == 0);
+
+  auto const first = sequencer.claim(3);
+  for(auto i = first; i != first + 3; ++i)
+    buffer[i] = i;
+  sequencer.publish(first, first + 2);
+  REQUIRE(processor.poll() == 3);
+  REQUIRE(processor.handler().batches == 1);
+  REQUIRE(processor.position().value() == -1);
+
+  auto const index = sequencer.claim();
+  buffer[index] = index;
+  sequencer.publish(index);
+  REQUIRE(processor.poll() == 1);
+  REQUIRE(processor.handler().batches == 2);
+  REQUIRE(processor.position().value() == 3);
+
+  REQUIRE(sequencer.try_claim(2) == 4);
+  buffer[4] = 4;
+  buffer[5] = 5;
+  sequencer.publish(4, 5);
+  REQUIRE(processor.poll() == 2);
+  REQUIRE(processor.position().value() == 3);
+  REQUIRE(processor.poll() == 0);
+  REQUIRE(processor.position().value() == 5);
+  REQUIRE(processor.handler().events == std::vector<int64_t>{0, 1, 2, 3, 4, 5});
+}
+
+
+TEST_CASE_TEMPLATE("batch event processor runs until halted", S,
+                   udisruptor::sequencer,
+                   udisruptor::basic_sequencer<udisruptor::parking_wait>,
+                   udisruptor::multisequencer) {
+  constexpr auto events_count = 10000;
+  udisruptor::ring_buffer<int64_t> buffer{32};
+  S sequencer{buffer.capacity()};
+  udisruptor::batch_event_processor<int64_t, batch_recorder, S> processor{
+    buffer, sequencer, batch_recorder{}, 8};
+
+  int64_t handled = 0;
+  std::thread consumer{[&] { handled = processor.run(); }};
+  for(auto i = 0; i != events_count; ++i) {
+    auto const index = sequencer.claim();
+    buffer[index] = index;
+    sequencer.publish(index);
+  }
+  sequencer.halt();
+  consumer.join();
+
+  REQUIRE(handled == events_count);
+  REQUIRE(processor.position().value() == events_count - 1);
+  auto const& events = processor.handler().events;
+  auto mismatches = 0;
+  for(auto i = 0; i != events_count; ++i)
+    if(events[i] != i)
+      ++mismatches;
+  REQUIRE(mismatches == 0);
+  REQUIRE(processor.handler().batches >= 1);
+}
+
+
+struct stage_handler {
+  std::vector<stage_handler const*> after;
+  std::atomic<bool> const* hold{nullptr};
+  std::atomic<int64_t> handled{0};
+  int mismatches{0};
+
+  void operator () (int64_t& event, int64_t index, bool) {
+    while(hold != nullptr && !hold->load())
+      std::this_thread::yield();
+    if(event != index)
+      ++mismatches;
+    for(auto before: after)
+      if(before->handled.load(std::memory_order_relaxed) <= index)
+        ++mismatches;
+    handled.store(index + 1, std::memory_order_relaxed);
+  }
+};
+
+
+TEST_CASE_TEMPLATE("topology runs stages in order", S,
+                   udisruptor::sequencer,
+                   udisruptor::basic_sequencer<udisruptor::parking_wait>,
+                   udisruptor::multisequencer) {
+  constexpr auto events_count = 10000;
+  udisruptor::ring_buffer<int64_t> buffer{16};
+  S sequencer{buffer.capacity()};
+
+  // a and b in parallel, c after both, d after c
+  stage_handler a, b, c, d;
+  c.after = {&a, &b};
+  d.after = {&c};
+  udisruptor::topology<int64_t, S> graph{buffer, sequencer, 4};
+  graph.handle_events_with(a, b).then(c).then(d);
+  REQUIRE(graph);
+  CHECK(graph.start());
+
+  for(auto i = 0; i != events_count; ++i) {
+    auto const index = sequencer.claim();
+    buffer[index] = index;
+    sequencer.publish(index);
+  }
+  graph.halt();
+
+  for(auto h: {&a, &b, &c, &d}) {
+    REQUIRE(h->handled == events_count);
+    REQUIRE(h->mismatches == 0);
+  }
+}
+
+
+TEST_CASE("topology gates producers on the last stage") {
+  udisruptor::ring_buffer<int64_t> buffer{4};
+  udisruptor::sequencer sequencer{buffer.capacity()};
+  std::atomic<bool> released{false};
+  stage_handler a, b;
+  b.hold = &released;
+  udisruptor::topology<int64_t> graph{buffer, sequencer};
+  graph.handle_events_with(a).then(b);
+
+  REQUIRE(sequencer.try_claim(4) == 0);
+  for(auto i = 0; i != 4; ++i)
+    buffer[i] = i;
+  sequencer.publish(0, 3);
+  graph.start();
+  while(a.handled != 4)
+    std::this_thread::yield();
+  REQUIRE(sequencer.try_claim() == udisruptor::sequence::invalid);
+
+  released = true;
+  auto index = udisruptor::sequence::invalid;
+  while(index == udisruptor::sequence::invalid)
+    index = sequencer.try_claim();
+  REQUIRE(index == 4);
+  buffer[index] = index;
+  sequencer.publish(index);
+  graph.halt();
+  REQUIRE(b.handled == 5);
+  REQUIRE(a.mismatches + b.mismatches == 0);
+}
+
+
+struct work_counter {
+  int64_t handled{0};
+  int64_t sum{0};
+  int mismatches{0};
+
+  void operator () (int64_t& event, int64_t index, bool) {
+    if(event != index)
+      ++mismatches;
+    ++handled;
+    sum += event;
+  }
+};
+
+
+TEST_CASE_TEMPLATE("worker pool hands every event to one worker", S,
+                   udisruptor::sequencer,
+                   udisruptor::basic_sequencer<udisruptor::parking_wait>,
+                   udisruptor::multisequencer) {
+  constexpr auto events_count = 20000;
+  udisruptor::ring_buffer<int64_t> buffer{64};
+  S sequencer{buffer.capacity()};
+  udisruptor::worker_pool<int64_t, work_counter, S> pool{buffer, sequencer, 4, 8};
+  REQUIRE(!!pool);
+  pool.start();
+
+  for(auto i = 0; i != events_count; ++i) {
+    auto const index = sequencer.claim();
+    buffer[index] = index;
+    sequencer.publish(index);
+  }
+  pool.halt();
+
+  int64_t handled = 0, sum = 0;
+  auto mismatches = 0;
+  for(auto w = 0; w != pool.workers(); ++w) {
+    handled += pool.handler(w).handled;
+    sum += pool.handler(w).sum;
+    mismatches += pool.handler(w).mismatches;
+  }
+  REQUIRE(mismatches == 0);
+  REQUIRE(handled == events_count);
+  REQUIRE(sum == int64_t(events_count) * (events_count - 1) / 2);
+  REQUIRE(pool.progress().value() == events_count - 1);
+}
+
+
+TEST_CASE("worker pool keeps progress under contended claims") {
+  for(auto round = 0; round != 50; ++round) {
+    udisruptor::ring_buffer<int64_t> buffer{8};
+    udisruptor::basic_sequencer<udisruptor::parking_wait> sequencer{buffer.capacity()};
+    udisruptor::worker_pool<int64_t, work_counter, decltype(sequencer)> pool{
+      buffer, sequencer, 4, 1};
+    pool.start();
+    for(auto i = 0; i != 5000; ++i) {
+      auto const index = sequencer.claim();
+      buffer[index] = index;
+      sequencer.publish(index);
+    }
+    pool.halt();
+    REQUIRE(pool.progress().value() == 4999);
+  }
+}
+
+
+TEST_CASE("worker pool gates producers on its progress") {
+  udisruptor::ring_buffer<int64_t> buffer{4};
+  udisruptor::sequencer sequencer{buffer.capacity()};
+  udisruptor::worker_pool<int64_t, work_counter> pool{buffer, sequencer, 2, 2};
+
+  REQUIRE(sequencer.try_claim(4) == 0);
+  for(auto i = 0; i != 4; ++i)
+    buffer[i] = i;
+  sequencer.publish(0, 3);
+  REQUIRE(sequencer.try_claim() == udisruptor::sequence::invalid);
+
+  pool.start();
+  while(pool.progress().value() != 3)
+    std::this_thread::yield();
+  REQUIRE(sequencer.try_claim(4) == 4);
+  for(auto i = 4; i != 8; ++i)
+    buffer[i] = i;
+  sequencer.publish(4, 7);
+  pool.halt();
+  REQUIRE(pool.progress().value() == 7);
+  REQUIRE(pool.handler(0).handled + pool.handler(1).handled == 8);
+}
+
+
+struct partition_recorder {
+  std::vector<int64_t> indices;
+  std::vector<int64_t> batch_ends;
+
+  void operator () (int64_t&, int64_t index, bool end_of_batch) {
+    indices.push_back(index);
+    if(end_of_batch)
+      batch_ends.push_back(index);
+  }
+};
+
+
+TEST_CASE("stripe and key affinity partitions") {
+  udisruptor::ring_buffer<int64_t> buffer{16};
+  for(auto i = 0; i != 16; ++i)
+    buffer[i] = i * 7;
+
+  partition_recorder striped;
+  udisruptor::stripe second_of_three{3, 1};
+  REQUIRE(second_of_three.handle(buffer, 2, 10, striped) == 3);
+  REQUIRE(second_of_three.handle(buffer, 11, 12, striped) == 0);
+  REQUIRE(second_of_three.handle(buffer, 13, 13, striped) == 1);
+  REQUIRE(striped.indices == std::vector<int64_t>{4, 7, 10, 13});
+  REQUIRE(striped.batch_ends == std::vector<int64_t>{10, 13});
+
+  // Keys are events modulo 4, which hash to themselves
+  partition_recorder keyed;
+  auto const key = [](int64_t event) { return event % 4; };
+  udisruptor::key_affinity<decltype(key)> third_of_four{key, {}, 4, 2};
+  REQUIRE(third_of_four.handle(buffer, 0, 9, keyed) == 2);
+  REQUIRE(third_of_four.handle(buffer, 3, 5, keyed) == 0);
+  REQUIRE(third_of_four.handle(buffer, 10, 10, keyed) == 1);
+  REQUIRE(keyed.indices == std::vector<int64_t>{2, 6, 10});
+  REQUIRE(keyed.batch_ends == std::vector<int64_t>{6, 10});
+}
+
+
+struct keyed_handler {
+  std::vector<int64_t> last_of_key = std::vector<int64_t>(16, -1);
+  int64_t handled{0};
+  int mismatches{0};
+
+  void operator () (int64_t& event, int64_t index, bool) {
+    auto& last = last_of_key[event % 16];
+    if(event != index || last >= index)
+      ++mismatches;
+    last = index;
+    ++handled;
+  }
+};
+
+
+TEST_CASE_TEMPLATE("handler groups share a stage", S,
+                   udisruptor::sequencer, udisruptor::multisequencer) {
+  constexpr auto events_count = 20000;
+  udisruptor::ring_buffer<int64_t> buffer{64};
+  S sequencer{buffer.capacity()};
+
+  std::vector<keyed_handler> stripes(3), keyed(4);
+  stage_handler last;
+  udisruptor::topology<int64_t, S> graph{buffer, sequencer, 16};
+  auto by_stripe = udisruptor::striped(stripes);
+  graph.handle_events_with(by_stripe);
+  graph.handle_events_with(udisruptor::by_key(keyed, [](int64_t event) {
+    return event % 16;
+  })).then(last);
+  graph.start();
+
+  for(auto i = 0; i != events_count; ++i) {
+    auto const index = sequencer.claim();
+    buffer[index] = index;
+    sequencer.publish(index);
+  }
+  graph.halt();
+
+  for(auto group: {&stripes, &keyed}) {
+    int64_t handled = 0;
+    for(auto const& h: *group) {
+      REQUIRE(h.mismatches == 0);
+      REQUIRE(h.handled > 0);
+      handled += h.handled;
+    }
+    REQUIRE(handled == events_count);
+  }
+  REQUIRE(stripes[1].handled == (events_count + 1) / 3);
+  REQUIRE(keyed[0].handled == events_count / 4);
+  REQUIRE(last.handled == events_count);
+  REQUIRE(last.mismatches == 0);
+}
+
+
+TEST_CASE_TEMPLATE("combined claims hand out disjoint ranges", S,
+                   udisruptor::multisequencer,
+                   udisruptor::basic_multisequencer<udisruptor::parking_wait>) {
+  constexpr auto producers_count = 4;
+  constexpr auto events_per_producer = 3000;
+  constexpr auto events_count = producers_count * events_per_producer;
+
+  udisruptor::ring_buffer<int64_t> buffer{64};
+  S sequencer{buffer.capacity()};
+  auto consumer_seq = sequencer.add_consumer();
+  // one producer more than slots takes the plain claim path
+  udisruptor::claim_combiner<S> combiner{sequencer, producers_count - 1, 4};
+
+  std::atomic<int> mismatches{0};
+  auto consumer = std::thread{[&] {
+    auto consumed = 0;
+    for(;;) {
+      auto const next = consumer_seq->next();
+      auto const last = sequencer.wait_for(next);
+      if(last == udisruptor::sequence::alerted)
+        break;
+      for(auto i = next; i <= last; ++i, ++consumed)
+        if(buffer[i] != i)
+          ++mismatches;
+      sequencer.commit(*consumer_seq, last);
+    }
+    if(consumed != events_count)
+      ++mismatches;
+  }};
+
+  std::vector<std::thread> producers;
+  for(auto p = 0; p != producers_count; ++p)
+    producers.emplace_back([&, p] {
+      auto producer = combiner.add_producer();
+      auto const n = p % 2 == 0 ? 1 : 3;
+      for(auto i = 0; i != events_per_producer; i += n) {
+        auto const first = producer.claim(n);
+        for(auto j = first; j != first + n; ++j)
+          buffer[j] = j;
+        producer.publish(first, first + n - 1);
+      }
+    });
+
+  for(auto& producer: producers)
+    producer.join();
+  sequencer.halt();
+  consumer.join();
+
+  REQUIRE(mismatches == 0);
+}
+
+
+TEST_CASE_TEMPLATE("scrambled index spreads a lap over cache lines", T,
+                   int8_t, int64_t, char[16], char[64]) {
+  for(auto capacity: {2, 8, 64, 1024}) {
+    udisruptor::scrambled_index<sizeof(T)> index;
+    index.reserve(capacity);
+    std::vector<int> visits(capacity);
+    for(auto n = 0; n != capacity; ++n) {
+      auto const slot = index(capacity * 3 + n);
+      REQUIRE(slot >= 0);
+      REQUIRE(slot < capacity);
+      ++visits[slot];
+      if(n != 0 && capacity * sizeof(T) >= 2 * udisruptor::sequence::cacheline) {
+        auto const line = slot * sizeof(T) / udisruptor::sequence::cacheline;
+        auto const previous = index(capacity * 3 + n - 1) * sizeof(T) / udisruptor::sequence::cacheline;
+        REQUIRE(line != previous);
+      }
+    }
+    for(auto v: visits)
+      REQUIRE(v == 1);
+  }
+}
+
+
+TEST_CASE("padded ring buffer slots") {
+  constexpr auto cacheline = udisruptor::sequence::cacheline;
+  udisruptor::ring_buffer<int64_t, udisruptor::linear_index, cacheline> buffer{8};
+  for(auto n = 0; n != 16; ++n)
+    buffer[n] = n;
+  for(auto n = 8; n != 16; ++n) {
+    REQUIRE(buffer[n] == n);
+    REQUIRE(reinterpret_cast<uintptr_t>(&buffer[n]) % cacheline == 0);
+  }
+}
+
+
+TEST_CASE("gating tree keeps the minimum in root") {
+  udisruptor::sequence root;
+  udisruptor::gating_tree tree{root, 20, 4};
+  std::vector<udisruptor::sequence*> consumers;
+  for(auto i = 0; i != 20; ++i)
+    consumers.push_back(tree.add_consumer());
+  REQUIRE(tree.add_consumer() == nullptr);
+
+  for(auto i = 0; i != 19; ++i)
+    REQUIRE(!tree.commit(*consumers[i], 10 + i));
+  REQUIRE(root.value() == udisruptor::sequence::invalid);
+  REQUIRE(tree.commit(*consumers[19], 5));
+  REQUIRE(root.value() == 5);
+  REQUIRE(tree.commit(*consumers[19], 50));
+  REQUIRE(root.value() == 10);
+  REQUIRE(!tree.commit(*consumers[5], 60));
+  REQUIRE(tree.commit(*consumers[0], 60));
+  REQUIRE(root.value() == 11);
+}
+
+
+TEST_CASE("gating tree hands out every leaf once to concurrent consumers") {
+  constexpr auto threads_count = 8;
+  constexpr auto consumers_count = 100;
+
+  udisruptor::sequence root;
+  udisruptor::gating_tree tree{root, consumers_count, 4};
+  std::vector<std::vector<udisruptor::sequence*>> added(threads_count);
+  std::vector<std::thread> threads;
+  for(auto t = 0; t != threads_count; ++t)
+    threads.emplace_back([&, t] {
+      while(auto consumer_seq = tree.add_consumer())
+        added[t].push_back(consumer_seq);
+    });
+  for(auto& thread: threads)
+    thread.join();
+
+  std::set<udisruptor::sequence*> leaves;
+  for(auto const& a: added)
+    leaves.insert(a.begin(), a.end());
+  REQUIRE(leaves.size() == consumers_count);
+  for(auto const& a: added)
+    for(auto consumer_seq: a)
+      tree.commit(*consumer_seq, 7);
+  REQUIRE(root.value() == 7);
+}
+
+
+TEST_CASE("gating tree gates producers on many consumers") {
+  constexpr auto consumers_count = 12;
+  constexpr auto events_count = 20000;
+
+  udisruptor::ring_buffer<int64_t> buffer{32};
+  udisruptor::multisequencer sequencer{buffer.capacity()};
+  udisruptor::gating_tree tree{*sequencer.add_consumer(), consumers_count, 3};
+
+  std::atomic<int> mismatches{0};
+  std::vector<std::thread> consumers;
+  for(auto c = 0; c != consumers_count; ++c)
+    consumers.emplace_back([&, consumer_seq = tree.add_consumer()] {
+      auto consumed = 0;
+      for(;;) {
+        auto const next = consumer_seq->next();
+        auto const last = sequencer.wait_for(next);
+        if(last == udisruptor::sequence::alerted)
+          break;
+        for(auto i = next; i <= last; ++i, ++consumed)
+          if(buffer[i] != i)
+            ++mismatches;
+        if(tree.commit(*consumer_seq, last))
+          sequencer.notify_consumed();
+      }
+      if(consumed != events_count)
+        ++mismatches;
+    });
+
+  for(auto i = 0; i != events_count; ++i) {
+    auto const index = sequencer.claim();
+    buffer[index] = index;
+    sequencer.publish(index);
+  }
+  sequencer.halt();
+  for(auto& consumer: consumers)
+    consumer.join();
+
+  REQUIRE(mismatches == 0);
+}
+
+
+TEST_CASE_TEMPLATE("fixed consumer count", S,
+                   udisruptor::basic_sequencer<udisruptor::yielding_wait, 2>,
+                   udisruptor::basic_multisequencer<udisruptor::yielding_wait,
+                                                    udisruptor::sequence_availability, 2>) {
+  S sequencer{4};
+  auto first = sequencer.add_consumer();
+  REQUIRE(!sequencer);
+  auto second = sequencer.add_consumer();
+  REQUIRE(!!sequencer);
+  REQUIRE(sequencer.add_consumer() == nullptr);
+
+  REQUIRE(sequencer.try_claim(4) == 0);
+  sequencer.publish(0, 3);
+  *first = 3;
+  REQUIRE(sequencer.try_claim() == udisruptor::sequence::invalid);
+  *second = 1;
+  REQUIRE(sequencer.try_claim(2) == 4);
+  REQUIRE(sequencer.try_claim() == udisruptor::sequence::invalid);
+}
+
+
+TEST_CASE_TEMPLATE("consumers join at cursor and leave", S,
+                   udisruptor::sequencer, udisruptor::multisequencer) {
+  S sequencer{4};
+  REQUIRE(!sequencer);
+  auto first = sequencer.add_consumer();
+  REQUIRE(first->value() == -1);
+  REQUIRE(!!sequencer);
+
+  REQUIRE(sequencer.try_claim(3) == 0);
+  sequencer.publish(0, 2);
+  auto second = sequencer.add_consumer();
+  REQUIRE(second->value() == 2);
+
+  *first = 2;
+  REQUIRE(sequencer.remove_consumer(first));
+  REQUIRE(!sequencer.remove_consumer(first));
+  REQUIRE(sequencer.try_claim(4) == 3);
+  sequencer.publish(3, 6);
+
+  // Without consumers producers gate on the cursor
+  REQUIRE(sequencer.remove_consumer(second));
+  REQUIRE(!sequencer);
+  REQUIRE(sequencer.try_claim(4) == 7);
+  sequencer.publish(7, 10);
+  REQUIRE(sequencer.try_claim(4) == 11);
+  sequencer.publish(11, 14);
+  auto third = sequencer.add_consumer();
+  REQUIRE(third == first);
+  REQUIRE(third->value() == 14);
+  REQUIRE(sequencer.try_claim(4) == 15);
+  REQUIRE(sequencer.try_claim() == udisruptor::sequence::invalid);
+}
+
+
+TEST_CASE("removing the slowest consumer wakes a gated producer") {
+  using namespace std::chrono;
+  udisruptor::basic_sequencer<udisruptor::parking_wait> sequencer{2};
+  auto caught_up = sequencer.add_consumer();
+  auto stuck = sequencer.add_consumer();
+  REQUIRE(sequencer.try_claim(2) == 0);
+  sequencer.publish(0, 1);
+  *caught_up = 1;
+
+  std::atomic<int64_t> claimed{udisruptor::sequence::invalid};
+  std::thread producer{[&] { claimed = sequencer.claim(); }};
+  std::this_thread::sleep_for(milliseconds{50});
+  REQUIRE(claimed == udisruptor::sequence::invalid);
+
+  REQUIRE(sequencer.remove_consumer(stuck));
+  auto const deadline = steady_clock::now() + seconds{2};
+  while(claimed == udisruptor::sequence::invalid && steady_clock::now() < deadline)
+    std::this_thread::sleep_for(milliseconds{1});
+  auto const woken = claimed.load();
+  if(woken == udisruptor::sequence::invalid)
+    sequencer.alert();
+  producer.join();
+  REQUIRE(woken == 2);
+}
+
+
+TEST_CASE_TEMPLATE("producers run on without consumers and gate on late joiners", S,
+                   udisruptor::basic_sequencer<udisruptor::parking_wait>,
+                   udisruptor::basic_multisequencer<udisruptor::parking_wait>) {
+  using namespace std::chrono;
+  S sequencer{8};
+  REQUIRE(sequencer.remove_consumer(sequencer.add_consumer()));
+
+  std::atomic<int64_t> produced{udisruptor::sequence::invalid};
+  auto const produce = [&](int count) {
+    for(auto i = 0; i != count; ++i) {
+      auto const index = sequencer.claim();
+      if(index < 0)
+        return;
+      sequencer.publish(index);
+      produced = index;
+    }
+  };
+  auto const wait_produced = [&](int64_t n) {
+    auto const deadline = steady_clock::now() + seconds{2};
+    while(produced != n && steady_clock::now() < deadline)
+      std::this_thread::sleep_for(milliseconds{1});
+    return produced.load();
+  };
+
+  std::thread producer{produce, 20};
+  auto const alone = wait_produced(19);
+  if(alone != 19)
+    sequencer.alert();
+  producer.join();
+  REQUIRE(alone == 19);
+
+  auto late = sequencer.add_consumer();
+  REQUIRE(late->value() == 19);
+  producer = std::thread{produce, 12};
+  auto const gated = wait_produced(27);
+  std::this_thread::sleep_for(milliseconds{20});
+  auto const parked = produced.load();
+  sequencer.commit(*late, 27);
+  auto const woken = wait_produced(31);
+  if(woken != 31)
+    sequencer.alert();
+  producer.join();
+  REQUIRE(gated == 27);
+  REQUIRE(parked == 27);
+  REQUIRE(woken == 31);
+}
+
+
+TEST_CASE_TEMPLATE("consumers join and leave while producing", S,
+                   udisruptor::sequencer, udisruptor::multisequencer) {
+  constexpr auto events_count = 20000;
+  constexpr auto joiners_count = 2;
+
+  udisruptor::ring_buffer<int64_t> buffer{16};
+  S sequencer{buffer.capacity()};
+  auto const main_seq = sequencer.add_consumer();
+
+  std::atomic<int> mismatches{0};
+  std::atomic<bool> done{false};
+
+  auto const consume = [&](udisruptor::sequence* consumer_seq, int limit) {
+    auto consumed = 0;
+    while(consumed < limit) {
+      auto const next = consumer_seq->next();
+      auto const last = sequencer.wait_for(next);
+      if(last == udisruptor::sequence::alerted)
+        break;
+      for(auto i = next; i <= last; ++i, ++consumed)
+        if(buffer[i] != i)
+          ++mismatches;
+      sequencer.commit(*consumer_seq, last);
+    }
+    return consumed;
+  };
+
+  std::vector<std::thread> threads;
+  threads.emplace_back([&] {
+    if(consume(main_seq, events_count) != events_count)
+      ++mismatches;
+  });
+  for(auto j = 0; j != joiners_count; ++j)
+    threads.emplace_back([&] {
+      while(!done.load()) {
+        auto const consumer_seq = sequencer.add_consumer();
+        consume(consumer_seq, 100);
+        if(!sequencer.remove_consumer(consumer_seq))
+          ++mismatches;
+      }
+    });
+
+  for(auto i = 0; i != events_count; ++i) {
+    auto const index = sequencer.claim();
+    buffer[index] = index;
+    sequencer.publish(index);
+  }
+
+  threads.front().join();
+  done = true;
+  sequencer.halt();
+  for(auto it = threads.begin() + 1; it != threads.end(); ++it)
+    it->join();
+
+  REQUIRE(mismatches == 0);
+}
+
+
+TEST_CASE_TEMPLATE("removed consumers can be freed while producing", S,
+                   udisruptor::sequencer, udisruptor::multisequencer) {
+  constexpr auto events_count = 20000;
+
+  S sequencer{16};
+  auto const main_seq = sequencer.add_consumer();
+  std::atomic<bool> done{false};
+  std::atomic<int> mismatches{0};
+
+  std::thread consumer{[&] {
+    for(;;) {
+      auto const last = sequencer.wait_for(main_seq->next());
+      if(last == udisruptor::sequence::alerted)
+        break;
+      sequencer.commit(*main_seq, last);
+    }
+  }};
+  std::thread churn{[&] {
+    while(!done.load()) {
+      auto joiner = std::make_unique<udisruptor::sequence>();
+      if(!sequencer.add_consumer(*joiner) || !sequencer.remove_consumer(joiner.get()))
+        ++mismatches;
+    }
+  }};
+
+  for(auto i = 0; i != events_count; ++i)
+    sequencer.publish(sequencer.claim());
+  done = true;
+  churn.join();
+  sequencer.halt();
+  consumer.join();
+
+  REQUIRE(mismatches == 0);
+  REQUIRE(main_seq->value() == events_count - 1);
+}
+
+
+TEST_CASE("fixed dependency count") {
+  udisruptor::sequence first{5}, second{3};
+  udisruptor::basic_barrier<udisruptor::yielding_wait, 2> barrier;
+  REQUIRE(barrier.wait(7) == 7);
+
+  REQUIRE(barrier.depends_on(first));
+  REQUIRE(barrier.wait(2) == 5);
+  REQUIRE(barrier.depends_on(second));
+  REQUIRE(!barrier.depends_on(second));
+  REQUIRE(barrier.wait(2) == 3);
+
+  second = 9;
+  REQUIRE(barrier.wait(4) == 5);
+}